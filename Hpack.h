@@ -0,0 +1,618 @@
+// Hpack.h
+#pragma once
+#ifndef HPACK_H
+#define HPACK_H
+
+// HPACK header compression for HTTP/2 (RFC 7541). Standalone and portable: it
+// does not depend on WinHTTP, which compresses headers internally for the
+// client's own HTTP/2 connections.
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <algorithm>
+
+namespace HttpClientLib {
+
+	namespace hpack {
+
+		// A header as carried in a header block; names are lowercase
+		struct HeaderField {
+			std::string name;
+			std::string value;
+			bool sensitive = false; // Encoded as never-indexed so intermediaries do not compress it either
+
+			HeaderField() = default;
+			HeaderField(std::string n, std::string v, bool s = false) : name(std::move(n)), value(std::move(v)), sensitive(s) {}
+
+			// RFC 7541 section 4.1: entry size counts 32 octets of overhead
+			size_t size() const { return name.size() + value.size() + 32; }
+
+			bool operator==(const HeaderField& other) const { return name == other.name && value == other.value; }
+		};
+
+		// Thrown for malformed header blocks; the HTTP/2 connection must treat it as COMPRESSION_ERROR
+		class HpackError : public std::runtime_error {
+		public:
+			using std::runtime_error::runtime_error;
+		};
+
+		namespace detail {
+
+			struct StaticEntry {
+				const char* name;
+				const char* value;
+			};
+
+			// RFC 7541 Appendix A
+			inline const std::array<StaticEntry, 61>& staticTable() {
+				static const std::array<StaticEntry, 61> table = { {
+				{ ":authority", "" },
+				{ ":method", "GET" },
+				{ ":method", "POST" },
+				{ ":path", "/" },
+				{ ":path", "/index.html" },
+				{ ":scheme", "http" },
+				{ ":scheme", "https" },
+				{ ":status", "200" },
+				{ ":status", "204" },
+				{ ":status", "206" },
+				{ ":status", "304" },
+				{ ":status", "400" },
+				{ ":status", "404" },
+				{ ":status", "500" },
+				{ "accept-charset", "" },
+				{ "accept-encoding", "gzip, deflate" },
+				{ "accept-language", "" },
+				{ "accept-ranges", "" },
+				{ "accept", "" },
+				{ "access-control-allow-origin", "" },
+				{ "age", "" },
+				{ "allow", "" },
+				{ "authorization", "" },
+				{ "cache-control", "" },
+				{ "content-disposition", "" },
+				{ "content-encoding", "" },
+				{ "content-language", "" },
+				{ "content-length", "" },
+				{ "content-location", "" },
+				{ "content-range", "" },
+				{ "content-type", "" },
+				{ "cookie", "" },
+				{ "date", "" },
+				{ "etag", "" },
+				{ "expect", "" },
+				{ "expires", "" },
+				{ "from", "" },
+				{ "host", "" },
+				{ "if-match", "" },
+				{ "if-modified-since", "" },
+				{ "if-none-match", "" },
+				{ "if-range", "" },
+				{ "if-unmodified-since", "" },
+				{ "last-modified", "" },
+				{ "link", "" },
+				{ "location", "" },
+				{ "max-forwards", "" },
+				{ "proxy-authenticate", "" },
+				{ "proxy-authorization", "" },
+				{ "range", "" },
+				{ "referer", "" },
+				{ "refresh", "" },
+				{ "retry-after", "" },
+				{ "server", "" },
+				{ "set-cookie", "" },
+				{ "strict-transport-security", "" },
+				{ "transfer-encoding", "" },
+				{ "user-agent", "" },
+				{ "vary", "" },
+				{ "via", "" },
+				{ "www-authenticate", "" },
+				} };
+				return table;
+			}
+
+			// RFC 7541 Appendix B; returns the code and bit length for each octet, then EOS
+			inline std::pair<const uint32_t*, const uint8_t*> huffmanTables() {
+				static const uint32_t huffmanCodes[257] = {
+					0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+					0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+					0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+					0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+					0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+					0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+					0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+					0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+					0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+					0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+					0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+					0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+					0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+					0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+					0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+					0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+					0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+					0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+					0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+					0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+					0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+					0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+					0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+					0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+					0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+					0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+					0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+					0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+					0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+					0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+					0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+					0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+					0x3fffffff
+				};
+				static const uint8_t huffmanLengths[257] = {
+					13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+					28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+					6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+					5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+					13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+					7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+					15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+					6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+					20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+					24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+					22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+					21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+					26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+					19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+					20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+					26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+					30
+				};
+				return { huffmanCodes, huffmanLengths };
+			}
+
+			inline uint32_t huffmanCode(unsigned symbol) { return huffmanTables().first[symbol]; }
+			inline uint8_t huffmanLength(unsigned symbol) { return huffmanTables().second[symbol]; }
+
+			// Number of octets the Huffman encoding of value takes
+			inline size_t huffmanEncodedLength(std::string_view value) {
+				uint64_t bits = 0;
+				for (unsigned char c : value) bits += huffmanLength(c);
+				return static_cast<size_t>((bits + 7) / 8);
+			}
+
+			inline void huffmanEncode(std::string_view value, std::string& out) {
+				uint64_t pending = 0; // Bits not yet written, right-aligned
+				unsigned count = 0;
+				for (unsigned char c : value) {
+					pending = (pending << huffmanLength(c)) | huffmanCode(c);
+					count += huffmanLength(c);
+					while (count >= 8) {
+						count -= 8;
+						out.push_back(static_cast<char>(pending >> count));
+					}
+				}
+				if (count > 0) {
+					// Pad with the most significant bits of EOS, which are all ones
+					out.push_back(static_cast<char>((pending << (8 - count)) | (0xFF >> count)));
+				}
+			}
+
+			// Decoding runs a finite-state machine over 4-bit nibbles. Each state is an
+			// internal node of the Huffman tree; a transition consumes a nibble and
+			// emits at most one symbol, since no code is shorter than 5 bits.
+			struct HuffmanTransition {
+				uint8_t state;
+				uint8_t flags;
+				uint8_t symbol;
+			};
+
+			enum : uint8_t { HuffmanEmit = 1, HuffmanAccept = 2, HuffmanFail = 4 };
+
+			inline const std::vector<HuffmanTransition>& huffmanDecodeTable() {
+				static const std::vector<HuffmanTransition> table = [] {
+					// Build the code tree: node 0 is the root, leaves hold their symbol
+					struct Node {
+						int children[2] = { -1, -1 };
+						int symbol = -1;
+					};
+					std::vector<Node> tree(1);
+					for (unsigned symbol = 0; symbol <= 256; ++symbol) {
+						int node = 0;
+						for (int bit = huffmanLength(symbol) - 1; bit >= 0; --bit) {
+							int b = (huffmanCode(symbol) >> bit) & 1;
+							if (tree[node].children[b] < 0) {
+								tree[node].children[b] = static_cast<int>(tree.size());
+								tree.emplace_back();
+							}
+							node = tree[node].children[b];
+						}
+						tree[node].symbol = static_cast<int>(symbol);
+					}
+
+					// Number the internal nodes; a valid end needs at most 7 one-bits of padding
+					std::vector<int> stateOf(tree.size(), -1);
+					std::vector<int> nodeOf;
+					std::vector<bool> paddable;
+					std::vector<std::pair<int, std::pair<int, bool>>> stack = { { 0, { 0, true } } };
+					while (!stack.empty()) {
+						auto [node, info] = stack.back();
+						stack.pop_back();
+						if (tree[node].symbol >= 0) continue;
+						stateOf[node] = static_cast<int>(nodeOf.size());
+						nodeOf.push_back(node);
+						paddable.push_back(info.second && info.first <= 7);
+						stack.push_back({ tree[node].children[0], { info.first + 1, false } });
+						stack.push_back({ tree[node].children[1], { info.first + 1, info.second } });
+					}
+
+					std::vector<HuffmanTransition> transitions(nodeOf.size() * 16);
+					for (size_t state = 0; state < nodeOf.size(); ++state) {
+						for (int nibble = 0; nibble < 16; ++nibble) {
+							HuffmanTransition& t = transitions[state * 16 + nibble];
+							int node = nodeOf[state];
+							for (int bit = 3; bit >= 0; --bit) {
+								node = tree[node].children[(nibble >> bit) & 1];
+								if (tree[node].symbol == 256) {
+									t.flags |= HuffmanFail;
+									break;
+								}
+								if (tree[node].symbol >= 0) {
+									t.flags |= HuffmanEmit;
+									t.symbol = static_cast<uint8_t>(tree[node].symbol);
+									node = 0;
+								}
+							}
+							if (!(t.flags & HuffmanFail)) {
+								t.state = static_cast<uint8_t>(stateOf[node]);
+								if (paddable[stateOf[node]]) t.flags |= HuffmanAccept;
+							}
+						}
+					}
+					return transitions;
+				}();
+				return table;
+			}
+
+			inline void huffmanDecode(const uint8_t* data, size_t size, std::string& out) {
+				const auto& table = huffmanDecodeTable();
+				uint8_t state = 0;
+				uint8_t flags = HuffmanAccept;
+				for (size_t i = 0; i < size; ++i) {
+					for (int shift = 4; shift >= 0; shift -= 4) {
+						const HuffmanTransition& t = table[state * 16u + ((data[i] >> shift) & 0xF)];
+						if (t.flags & HuffmanFail) throw HpackError("Huffman string contains EOS");
+						if (t.flags & HuffmanEmit) out.push_back(static_cast<char>(t.symbol));
+						state = t.state;
+						flags = t.flags;
+					}
+				}
+				if (!(flags & HuffmanAccept)) throw HpackError("Invalid Huffman padding");
+			}
+
+			// RFC 7541 section 5.1: integer with an N-bit prefix; first carries the pattern bits
+			inline void encodeInteger(uint64_t value, int prefixBits, uint8_t first, std::string& out) {
+				uint64_t limit = (1u << prefixBits) - 1;
+				if (value < limit) {
+					out.push_back(static_cast<char>(first | value));
+					return;
+				}
+				out.push_back(static_cast<char>(first | limit));
+				value -= limit;
+				while (value >= 128) {
+					out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+					value >>= 7;
+				}
+				out.push_back(static_cast<char>(value));
+			}
+
+			inline uint64_t decodeInteger(const uint8_t*& p, const uint8_t* end, int prefixBits) {
+				if (p == end) throw HpackError("Truncated integer");
+				uint64_t limit = (1u << prefixBits) - 1;
+				uint64_t value = *p++ & limit;
+				if (value < limit) return value;
+				for (int shift = 0;; shift += 7) {
+					if (p == end) throw HpackError("Truncated integer");
+					if (shift > 56) throw HpackError("Integer overflow");
+					uint8_t byte = *p++;
+					value += static_cast<uint64_t>(byte & 0x7F) << shift;
+					if (!(byte & 0x80)) return value;
+				}
+			}
+
+			// RFC 7541 section 5.2: uses Huffman coding unless it would be longer, as the RFC examples do
+			inline void encodeString(std::string_view value, bool allowHuffman, std::string& out) {
+				size_t huffmanSize = allowHuffman ? huffmanEncodedLength(value) : value.size() + 1;
+				if (huffmanSize <= value.size()) {
+					encodeInteger(huffmanSize, 7, 0x80, out);
+					huffmanEncode(value, out);
+				}
+				else {
+					encodeInteger(value.size(), 7, 0x00, out);
+					out.append(value.data(), value.size());
+				}
+			}
+
+			inline std::string decodeString(const uint8_t*& p, const uint8_t* end) {
+				if (p == end) throw HpackError("Truncated string");
+				bool huffman = (*p & 0x80) != 0;
+				uint64_t length = decodeInteger(p, end, 7);
+				if (length > static_cast<uint64_t>(end - p)) throw HpackError("String exceeds header block");
+				std::string value;
+				if (huffman) {
+					value.reserve(static_cast<size_t>(length) * 8 / 5);
+					huffmanDecode(p, static_cast<size_t>(length), value);
+				}
+				else {
+					value.assign(reinterpret_cast<const char*>(p), static_cast<size_t>(length));
+				}
+				p += length;
+				return value;
+			}
+
+		} // namespace detail
+
+		// The dynamic table shared by one direction of a connection (RFC 7541 section 2.3.2).
+		// Newest entries come first; index 62 is the most recent insertion.
+		class DynamicTable {
+		public:
+			explicit DynamicTable(size_t maxSize = 4096) : max_size_(maxSize) {}
+
+			void add(HeaderField field) {
+				size_t fieldSize = field.size();
+				// An entry larger than the table empties it and is not stored
+				evictTo(fieldSize > max_size_ ? 0 : max_size_ - fieldSize);
+				if (fieldSize <= max_size_) {
+					size_ += fieldSize;
+					entries_.push_front(std::move(field));
+					++inserted_;
+				}
+			}
+
+			void setMaxSize(size_t maxSize) {
+				max_size_ = maxSize;
+				evictTo(maxSize);
+			}
+
+			// Entry at a 0-based position, newest first
+			const HeaderField& at(size_t position) const { return entries_[position]; }
+			size_t count() const { return entries_.size(); }
+			size_t size() const { return size_; }
+			size_t maxSize() const { return max_size_; }
+			uint64_t inserted() const { return inserted_; }
+
+		private:
+			void evictTo(size_t target) {
+				while (size_ > target && !entries_.empty()) {
+					size_ -= entries_.back().size();
+					entries_.pop_back();
+				}
+			}
+
+			std::deque<HeaderField> entries_;
+			size_t size_ = 0;
+			size_t max_size_;
+			uint64_t inserted_ = 0;
+		};
+
+		// Encodes header lists into header blocks for one connection
+		class Encoder {
+		public:
+			explicit Encoder(size_t maxTableSize = 4096) : table_(maxTableSize) {
+				const auto& statics = detail::staticTable();
+				for (size_t i = statics.size(); i-- > 0;) {
+					std::string name = statics[i].name;
+					static_names_[name] = i + 1;
+					static_fields_[name + '\0' + statics[i].value] = i + 1;
+				}
+			}
+
+			// Applies the peer's SETTINGS_HEADER_TABLE_SIZE; the change is signalled in the next block
+			void setMaxTableSize(size_t maxSize) {
+				pending_size_update_ = true;
+				pending_min_size_ = (std::min)(pending_min_size_, maxSize);
+				table_.setMaxSize(maxSize);
+				prune();
+			}
+
+			// Disables Huffman coding, e.g. for debugging; on by default
+			void setHuffman(bool enabled) { huffman_ = enabled; }
+
+			// Appends the header block for fields to out
+			void encode(const std::vector<HeaderField>& fields, std::string& out) {
+				if (pending_size_update_) {
+					// A shrink followed by a grow must signal both (RFC 7541 section 4.2)
+					if (pending_min_size_ < table_.maxSize()) {
+						detail::encodeInteger(pending_min_size_, 5, 0x20, out);
+					}
+					detail::encodeInteger(table_.maxSize(), 5, 0x20, out);
+					pending_size_update_ = false;
+					pending_min_size_ = SIZE_MAX;
+				}
+				for (const auto& field : fields) {
+					encodeField(field, out);
+				}
+			}
+
+			std::string encode(const std::vector<HeaderField>& fields) {
+				std::string out;
+				encode(fields, out);
+				return out;
+			}
+
+			const DynamicTable& table() const { return table_; }
+
+		private:
+			// Short credentials are easy to guess one compressed byte at a time (RFC 7541 section 7.1.3)
+			static bool neverIndex(const HeaderField& field) {
+				return field.sensitive || field.name == "authorization" || field.name == "proxy-authorization" ||
+					(field.name == "cookie" && field.value.size() < 20);
+			}
+
+			void encodeField(const HeaderField& field, std::string& out) {
+				std::string key = field.name + '\0' + field.value;
+				bool never = neverIndex(field);
+
+				if (!never) {
+					size_t index = findField(key);
+					if (index) {
+						detail::encodeInteger(index, 7, 0x80, out);
+						return;
+					}
+				}
+
+				size_t nameIndex = findName(field.name);
+				bool index = !never && field.size() <= table_.maxSize();
+				uint8_t pattern = never ? 0x10 : index ? 0x40 : 0x00;
+				int prefix = index ? 6 : 4;
+				detail::encodeInteger(nameIndex, prefix, pattern, out);
+				if (!nameIndex) {
+					detail::encodeString(field.name, huffman_, out);
+				}
+				detail::encodeString(field.value, huffman_, out);
+
+				if (index) {
+					table_.add(HeaderField(field.name, field.value));
+					// Map to the insertion number so indexes stay valid as older entries are evicted
+					fields_[key] = table_.inserted();
+					names_[field.name] = table_.inserted();
+					prune();
+				}
+			}
+
+			// Converts an insertion number to the HPACK index, or 0 if it was evicted
+			size_t indexOf(uint64_t insertion) const {
+				uint64_t age = table_.inserted() - insertion;
+				return age < table_.count() ? static_cast<size_t>(age) + 62 : 0;
+			}
+
+			size_t findField(const std::string& key) const {
+				auto it = fields_.find(key);
+				if (it != fields_.end()) {
+					if (size_t index = indexOf(it->second)) return index;
+				}
+				auto st = static_fields_.find(key);
+				return st == static_fields_.end() ? 0 : st->second;
+			}
+
+			size_t findName(const std::string& name) const {
+				// Static indexes are smaller, so they encode in fewer bytes
+				auto st = static_names_.find(name);
+				if (st != static_names_.end()) return st->second;
+				auto it = names_.find(name);
+				return it == names_.end() ? 0 : indexOf(it->second);
+			}
+
+			// Drops lookup entries for evicted table entries
+			void prune() {
+				uint64_t oldest = table_.inserted() - table_.count();
+				if (fields_.size() <= 2 * table_.count() + 16) return;
+				for (auto it = fields_.begin(); it != fields_.end();) {
+					it = it->second <= oldest ? fields_.erase(it) : std::next(it);
+				}
+				for (auto it = names_.begin(); it != names_.end();) {
+					it = it->second <= oldest ? names_.erase(it) : std::next(it);
+				}
+			}
+
+			DynamicTable table_;
+			bool huffman_ = true;
+			bool pending_size_update_ = false;
+			size_t pending_min_size_ = SIZE_MAX;
+			std::unordered_map<std::string, size_t> static_fields_;
+			std::unordered_map<std::string, size_t> static_names_;
+			std::unordered_map<std::string, uint64_t> fields_;
+			std::unordered_map<std::string, uint64_t> names_;
+		};
+
+		// Decodes header blocks for one connection
+		class Decoder {
+		public:
+			// maxTableSize is the SETTINGS_HEADER_TABLE_SIZE we advertised
+			explicit Decoder(size_t maxTableSize = 4096, size_t maxHeaderListSize = 64 * 1024)
+				: table_(maxTableSize), table_limit_(maxTableSize), max_header_list_size_(maxHeaderListSize) {}
+
+			// Changes the advertised limit; the peer must acknowledge it with a size update
+			void setMaxTableSize(size_t maxSize) { table_limit_ = maxSize; }
+
+			// Decodes one complete header block; throws HpackError if it is malformed
+			std::vector<HeaderField> decode(const uint8_t* data, size_t size) {
+				std::vector<HeaderField> fields;
+				const uint8_t* p = data;
+				const uint8_t* end = data + size;
+				size_t listSize = 0;
+				bool fieldSeen = false;
+				while (p < end) {
+					uint8_t byte = *p;
+					if (byte & 0x80) {
+						// Indexed header field
+						fields.push_back(lookup(detail::decodeInteger(p, end, 7)));
+					}
+					else if (byte & 0x40) {
+						// Literal with incremental indexing
+						fields.push_back(readLiteral(p, end, 6));
+						table_.add(HeaderField(fields.back().name, fields.back().value));
+					}
+					else if (byte & 0x20) {
+						// Dynamic table size update, only allowed before the first field
+						if (fieldSeen) throw HpackError("Table size update after a header field");
+						uint64_t maxSize = detail::decodeInteger(p, end, 5);
+						if (maxSize > table_limit_) throw HpackError("Table size update exceeds the advertised limit");
+						table_.setMaxSize(static_cast<size_t>(maxSize));
+						continue;
+					}
+					else {
+						// Literal without indexing (0000) or never indexed (0001)
+						bool never = (byte & 0x10) != 0;
+						fields.push_back(readLiteral(p, end, 4));
+						fields.back().sensitive = never;
+					}
+					fieldSeen = true;
+					listSize += fields.back().size();
+					if (listSize > max_header_list_size_) throw HpackError("Header list too large");
+				}
+				return fields;
+			}
+
+			std::vector<HeaderField> decode(std::string_view block) {
+				return decode(reinterpret_cast<const uint8_t*>(block.data()), block.size());
+			}
+
+			const DynamicTable& table() const { return table_; }
+
+		private:
+			HeaderField lookup(uint64_t index) const {
+				const auto& statics = detail::staticTable();
+				if (index == 0) throw HpackError("Index 0 is not valid");
+				if (index <= statics.size()) {
+					return HeaderField(statics[index - 1].name, statics[index - 1].value);
+				}
+				uint64_t position = index - statics.size() - 1;
+				if (position >= table_.count()) throw HpackError("Index beyond the dynamic table");
+				return table_.at(static_cast<size_t>(position));
+			}
+
+			HeaderField readLiteral(const uint8_t*& p, const uint8_t* end, int prefixBits) const {
+				uint64_t nameIndex = detail::decodeInteger(p, end, prefixBits);
+				HeaderField field;
+				field.name = nameIndex ? lookup(nameIndex).name : detail::decodeString(p, end);
+				field.value = detail::decodeString(p, end);
+				return field;
+			}
+
+			DynamicTable table_;
+			size_t table_limit_;
+			size_t max_header_list_size_;
+		};
+
+	} // namespace hpack
+
+} // namespace HttpClientLib
+
+#endif // HPACK_H
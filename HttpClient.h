@@ -12,6 +12,29 @@
 #include <regex>
 #include <memory>
 #include <sstream>
+#include <string_view>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <atomic>
+#include <cmath>
+#include <list>
+#include <map>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <stop_token>
+#include <random>
+#include <optional>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <charconv>
 #include "json.hpp"
 
 // Link with WinHTTP library
@@ -22,6 +45,384 @@ namespace HttpClientLib {
 	// Forward declaration
 	class HttpResponse;
 
+	// Classifies why a request produced no usable response
+	enum class ErrorKind {
+		None,           // A response was received (any status code)
+		InvalidRequest, // Malformed URL or request data; never retried
+		Transport,      // WinHTTP failed to connect, send or receive
+		CircuitOpen,    // Rejected locally because the host's circuit breaker is open
+		Overloaded,     // Shed locally because the host's concurrency limit was reached
+		Aborted,        // A streaming body callback stopped the transfer
+		Timeout,        // A phase timeout or the request deadline expired
+		Cancelled       // The caller's std::stop_token requested a stop
+	};
+
+	// Receives a streamed response body chunk by chunk. head carries the status
+	// code and headers; returning false aborts the transfer.
+	using BodyCallback = std::function<bool(const HttpResponse& head, const char* data, size_t size)>;
+
+	namespace detail {
+
+		// Case-insensitive ASCII comparison, used for header names and methods
+		inline bool equalsIgnoreCase(const std::string& a, const std::string& b) {
+			return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(),
+				[](unsigned char x, unsigned char y) { return std::tolower(x) == std::tolower(y); });
+		}
+
+		// Methods that RFC 9110 defines as idempotent and therefore safe to resend
+		inline bool isIdempotentMethod(const std::string& method) {
+			return method == "GET" || method == "HEAD" || method == "PUT" ||
+				method == "DELETE" || method == "OPTIONS" || method == "TRACE";
+		}
+
+		// Builds a filesystem path from a UTF-8 string; a plain std::string would be read in the ANSI code page
+		inline std::filesystem::path pathFromUtf8(const std::string& utf8) {
+			return std::filesystem::path(std::u8string(utf8.begin(), utf8.end()));
+		}
+
+		// Parses an HTTP-date in IMF-fixdate, RFC 850 or asctime form
+		inline std::optional<std::chrono::system_clock::time_point> parseHttpDate(const std::string& value) {
+			static const char* months[] = { "jan", "feb", "mar", "apr", "may", "jun",
+				"jul", "aug", "sep", "oct", "nov", "dec" };
+			std::vector<std::string> tokens;
+			std::string token;
+			for (char c : value + " ") {
+				if (c == ' ' || c == ',' || c == '-' || c == '\t') {
+					if (!token.empty()) tokens.push_back(token);
+					token.clear();
+				}
+				else {
+					token += c;
+				}
+			}
+
+			int day = -1, month = -1, year = -1, hh = -1, mm = -1, ss = -1;
+			for (const auto& t : tokens) {
+				if (t.find(':') != std::string::npos) {
+					if (std::sscanf(t.c_str(), "%d:%d:%d", &hh, &mm, &ss) != 3) return std::nullopt;
+				}
+				else if (std::isdigit(static_cast<unsigned char>(t[0]))) {
+					int n = std::atoi(t.c_str());
+					if (day < 0 && t.size() <= 2) day = n;
+					else if (year < 0) year = (t.size() <= 2) ? (n < 70 ? 2000 + n : 1900 + n) : n;
+				}
+				else if (t.size() == 3 && month < 0) {
+					for (int i = 0; i < 12; ++i) {
+						if (equalsIgnoreCase(t, months[i])) month = i + 1;
+					}
+				}
+			}
+			if (day < 1 || month < 1 || year < 0 || hh < 0 || mm < 0 || ss < 0) return std::nullopt;
+
+			std::chrono::year_month_day ymd{ std::chrono::year{ year }, std::chrono::month{ static_cast<unsigned>(month) },
+				std::chrono::day{ static_cast<unsigned>(day) } };
+			if (!ymd.ok()) return std::nullopt;
+			std::chrono::sys_seconds parsed = std::chrono::sys_days{ ymd } + std::chrono::hours{ hh } +
+				std::chrono::minutes{ mm } + std::chrono::seconds{ ss };
+			// Pin dates to [epoch, far future] so the clock conversion and later
+			// subtractions cannot overflow (year 9999 does not fit a nanosecond clock)
+			using Clock = std::chrono::system_clock;
+			const Clock::time_point latest{ (Clock::duration::max)() / 2 };
+			if (parsed >= std::chrono::floor<std::chrono::seconds>(latest)) return latest;
+			if (parsed < std::chrono::sys_seconds{}) return Clock::time_point{};
+			return parsed;
+		}
+
+		// Parses a Retry-After value (delta-seconds or HTTP-date) into a wait duration
+		inline std::optional<std::chrono::milliseconds> parseRetryAfter(const std::string& value) {
+			if (value.empty()) return std::nullopt;
+			if (std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c); })) {
+				// Saturated far above any sensible limit so the conversion to milliseconds cannot overflow
+				return std::chrono::seconds{ (std::min)(std::strtoll(value.c_str(), nullptr, 10), 1LL << 32) };
+			}
+			auto date = parseHttpDate(value);
+			if (!date) return std::nullopt;
+			auto delta = std::chrono::duration_cast<std::chrono::milliseconds>(*date - std::chrono::system_clock::now());
+			return (std::max)(delta, std::chrono::milliseconds{ 0 });
+		}
+
+		// Per-thread generator for backoff jitter
+		inline std::mt19937_64& randomEngine() {
+			thread_local std::mt19937_64 engine{ std::random_device{}() };
+			return engine;
+		}
+
+		inline std::string toLower(std::string value) {
+			std::transform(value.begin(), value.end(), value.begin(),
+				[](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+			return value;
+		}
+
+		inline std::string trim(const std::string& str) {
+			size_t first = str.find_first_not_of(" \t\r\n");
+			size_t last = str.find_last_not_of(" \t\r\n");
+			return (first == std::string::npos) ? "" : str.substr(first, last - first + 1);
+		}
+
+		// Finds a header by name, ignoring case; returns nullptr if absent
+		inline const std::string* findHeader(const std::unordered_map<std::string, std::string>& headers,
+			const std::string& name) {
+			auto it = headers.find(name);
+			if (it != headers.end()) return &it->second;
+			for (const auto& [key, value] : headers) {
+				if (equalsIgnoreCase(key, name)) return &value;
+			}
+			return nullptr;
+		}
+
+		// Splits a comma-separated header value into trimmed, non-empty items
+		inline std::vector<std::string> splitList(const std::string& value) {
+			std::vector<std::string> items;
+			std::string item;
+			std::istringstream stream(value);
+			while (std::getline(stream, item, ',')) {
+				item = trim(item);
+				if (!item.empty()) items.push_back(item);
+			}
+			return items;
+		}
+
+		// Parses Cache-Control directives into lowercase names and unquoted values
+		inline std::unordered_map<std::string, std::string> parseCacheControl(const std::string& value) {
+			std::unordered_map<std::string, std::string> directives;
+			for (const auto& item : splitList(value)) {
+				auto eq = item.find('=');
+				std::string name = toLower(trim(item.substr(0, eq)));
+				std::string arg = eq == std::string::npos ? "" : trim(item.substr(eq + 1));
+				if (arg.size() >= 2 && arg.front() == '"' && arg.back() == '"') {
+					arg = arg.substr(1, arg.size() - 2);
+				}
+				directives[name] = arg;
+			}
+			return directives;
+		}
+
+		// Reads a delta-seconds directive argument; nullopt if absent or malformed
+		inline std::optional<long long> deltaSeconds(const std::unordered_map<std::string, std::string>& directives,
+			const std::string& name) {
+			auto it = directives.find(name);
+			if (it == directives.end() || it->second.empty() ||
+				!std::all_of(it->second.begin(), it->second.end(), [](unsigned char c) { return std::isdigit(c); })) {
+				return std::nullopt;
+			}
+			return std::strtoll(it->second.c_str(), nullptr, 10);
+		}
+
+		// Hierarchical timing wheel with 1 ms ticks: four levels of 64 slots reach about
+		// 4.6 hours, and scheduling or cancelling a timer is O(1) however many are pending.
+		// One background thread advances the wheel and runs due callbacks; it sleeps while
+		// the wheel is empty and otherwise wakes at most once per 64 ticks.
+		class TimerWheel {
+		public:
+			using Clock = std::chrono::steady_clock;
+
+			// The process-wide wheel. It is never destroyed, so its thread cannot be
+			// joined under the loader lock when the library lives in a DLL.
+			static TimerWheel& shared() {
+				static TimerWheel* wheel = new TimerWheel();
+				return *wheel;
+			}
+
+			TimerWheel() : origin_(Clock::now()), slots_(kLevels * kSlots), thread_([this]() { run(); }) {}
+
+			~TimerWheel() {
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					stopping_ = true;
+				}
+				wake_.notify_one();
+				thread_.join();
+			}
+
+			TimerWheel(const TimerWheel&) = delete;
+			TimerWheel& operator=(const TimerWheel&) = delete;
+
+			// Runs callback on the wheel's thread once when has passed; returns an id for cancel()
+			uint64_t schedule(Clock::time_point when, std::function<void()> callback) {
+				std::lock_guard<std::mutex> lock(mutex_);
+				uint64_t id = ++next_id_;
+				if (timers_.empty()) {
+					// The thread sleeps without advancing while idle; catch up in O(1) so it
+					// neither steps through the idle time nor files the timer against a stale tick
+					for (auto& entries : slots_) entries.clear();
+					auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - origin_);
+					current_ = (std::max)(current_, static_cast<uint64_t>(elapsed.count()));
+				}
+				uint64_t tick = when <= origin_ ? 0
+					: static_cast<uint64_t>(std::chrono::ceil<std::chrono::milliseconds>(when - origin_).count());
+				timers_.emplace(id, Timer{ tick, std::move(callback) });
+				place(id, tick);
+				if (tick < wake_tick_) {
+					wake_.notify_one();
+				}
+				return id;
+			}
+
+			// Removes a pending timer; false if it has already fired or is firing
+			bool cancel(uint64_t id) {
+				std::lock_guard<std::mutex> lock(mutex_);
+				return timers_.erase(id) > 0;
+			}
+
+			size_t pending() const {
+				std::lock_guard<std::mutex> lock(mutex_);
+				return timers_.size();
+			}
+
+		private:
+			static constexpr int kLevels = 4;
+			static constexpr int kSlotBits = 6;
+			static constexpr uint64_t kSlots = uint64_t{ 1 } << kSlotBits;
+			static constexpr uint64_t kMask = kSlots - 1;
+
+			struct Timer {
+				uint64_t tick;
+				std::function<void()> callback;
+			};
+
+			std::vector<uint64_t>& slot(int level, uint64_t tick) {
+				return slots_[level * kSlots + ((tick >> (kSlotBits * level)) & kMask)];
+			}
+
+			// Files a timer at the coarsest level whose span still separates it from now
+			void place(uint64_t id, uint64_t tick) {
+				tick = (std::max)(tick, current_ + 1); // Overdue timers fire on the next tick
+				uint64_t delta = tick - current_;
+				int level = 0;
+				while (level < kLevels - 1 && delta >= (uint64_t{ 1 } << (kSlotBits * (level + 1)))) {
+					++level;
+				}
+				// Past the wheel's reach: park in the furthest slot and re-file when it cascades
+				uint64_t reach = uint64_t{ 1 } << (kSlotBits * kLevels);
+				if (delta >= reach) {
+					tick = current_ + reach - 1;
+				}
+				slot(level, tick).push_back(id);
+			}
+
+			// Advances to target, collecting the callbacks of timers that came due
+			void advanceTo(uint64_t target, std::vector<std::function<void()>>& due) {
+				if (timers_.empty()) {
+					// Only cancelled ids remain; drop them instead of stepping through idle time
+					for (auto& entries : slots_) entries.clear();
+					current_ = (std::max)(current_, target);
+					return;
+				}
+				while (current_ < target) {
+					++current_;
+					// Cascade higher levels first so their timers can reach level 0 this tick
+					for (int level = kLevels - 1; level >= 1; --level) {
+						if ((current_ & ((uint64_t{ 1 } << (kSlotBits * level)) - 1)) != 0) continue;
+						std::vector<uint64_t> entries;
+						entries.swap(slot(level, current_));
+						for (uint64_t id : entries) {
+							auto it = timers_.find(id);
+							if (it != timers_.end()) place(id, it->second.tick);
+						}
+					}
+					std::vector<uint64_t> entries;
+					entries.swap(slot(0, current_));
+					for (uint64_t id : entries) {
+						auto it = timers_.find(id);
+						if (it == timers_.end()) continue; // Cancelled
+						if (it->second.tick > current_) {
+							place(id, it->second.tick);
+							continue;
+						}
+						due.push_back(std::move(it->second.callback));
+						timers_.erase(it);
+					}
+				}
+			}
+
+			// The next tick that can fire a timer or must cascade a higher level
+			uint64_t nextTick() {
+				uint64_t boundary = (current_ | kMask) + 1;
+				for (uint64_t tick = current_ + 1; tick < boundary; ++tick) {
+					if (!slot(0, tick).empty()) return tick;
+				}
+				return boundary;
+			}
+
+			void run() {
+				std::unique_lock<std::mutex> lock(mutex_);
+				std::vector<std::function<void()>> due;
+				while (!stopping_) {
+					auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - origin_);
+					advanceTo(static_cast<uint64_t>(elapsed.count()), due);
+					if (!due.empty()) {
+						lock.unlock();
+						for (auto& callback : due) {
+							callback();
+						}
+						due.clear();
+						lock.lock();
+						continue;
+					}
+					if (timers_.empty()) {
+						wake_tick_ = UINT64_MAX;
+						wake_.wait(lock);
+					}
+					else {
+						wake_tick_ = nextTick();
+						wake_.wait_until(lock, origin_ + std::chrono::milliseconds{ static_cast<long long>(wake_tick_) });
+					}
+				}
+			}
+
+			const Clock::time_point origin_;
+			mutable std::mutex mutex_;
+			std::condition_variable wake_;
+			std::unordered_map<uint64_t, Timer> timers_;
+			std::vector<std::vector<uint64_t>> slots_;
+			uint64_t current_ = 0;
+			uint64_t next_id_ = 0;
+			uint64_t wake_tick_ = UINT64_MAX;
+			bool stopping_ = false;
+			// Declared last so every other member is initialized before the thread starts
+			std::thread thread_;
+		};
+
+		// Makes a request method's stop token visible to everything it calls on this thread.
+		// A scope without a stoppable token keeps the enclosing one.
+		class StopScope {
+		public:
+			explicit StopScope(std::stop_token stop) : saved_(current()) {
+				if (stop.stop_possible()) current() = std::move(stop);
+			}
+
+			~StopScope() { current() = std::move(saved_); }
+
+			StopScope(const StopScope&) = delete;
+			StopScope& operator=(const StopScope&) = delete;
+
+			static const std::stop_token& token() { return current(); }
+
+		private:
+			static std::stop_token& current() {
+				thread_local std::stop_token token;
+				return token;
+			}
+
+			std::stop_token saved_;
+		};
+
+		// Sleeps for delay, waking early if this thread's request is stopped; false if it was
+		inline bool sleepUnlessStopped(std::chrono::milliseconds delay) {
+			const std::stop_token& stop = StopScope::token();
+			if (!stop.stop_possible()) {
+				std::this_thread::sleep_for(delay);
+				return true;
+			}
+			std::mutex mutex;
+			std::condition_variable_any wake;
+			std::unique_lock<std::mutex> lock(mutex);
+			wake.wait_for(lock, stop, delay, []() { return false; });
+			return !stop.stop_requested();
+		}
+
+	} // namespace detail
+
 	// Helper RAII wrapper for HINTERNET handles
 	class WinHttpHandle {
 	public:
@@ -52,6 +453,12 @@ namespace HttpClientLib {
 		}
 
 		HINTERNET get() const { return handle_; }
+		// Gives up ownership without closing the handle
+		HINTERNET release() {
+			HINTERNET handle = handle_;
+			handle_ = nullptr;
+			return handle;
+		}
 		void reset(HINTERNET handle = nullptr) {
 			if (handle_) {
 				WinHttpCloseHandle(handle_);
@@ -63,23 +470,173 @@ namespace HttpClientLib {
 		HINTERNET handle_;
 	};
 
+	namespace detail {
+
+		// Converts UTF-8 string to wide string (UTF-16)
+		inline std::wstring toWideString(const std::string& utf8Str) {
+			if (utf8Str.empty()) return std::wstring();
+			int size_needed = MultiByteToWideChar(CP_UTF8, 0, utf8Str.c_str(), static_cast<int>(utf8Str.length()), NULL, 0);
+			if (size_needed == 0) {
+				throw std::runtime_error("Failed to convert string to wide string.");
+			}
+			std::wstring wideStr(size_needed, 0);
+			MultiByteToWideChar(CP_UTF8, 0, utf8Str.c_str(), static_cast<int>(utf8Str.length()), &wideStr[0], size_needed);
+			// Remove the null terminator added by MultiByteToWideChar
+			if (!wideStr.empty() && wideStr.back() == L'\0') {
+				wideStr.pop_back();
+			}
+			return wideStr;
+		}
+
+		// Parses the URL into scheme, host, port, and path (including any query string)
+		inline bool parseUrl(const std::string& url, std::string& scheme, std::string& host,
+			unsigned short& port, std::string& path) {
+			static const std::regex urlRegex(R"((https?)://([^/:]+)(?::(\d+))?([^?]*)?(\?.*)?$)");
+			std::smatch match;
+			if (std::regex_match(url, match, urlRegex)) {
+				scheme = match[1].str();
+				host = match[2].str();
+				port = scheme == "https" ? 443 : 80;
+				if (match[3].matched) {
+					// from_chars cannot throw; out-of-range ports make the URL invalid instead of wrapping
+					unsigned long value = 0;
+					const char* first = &*match[3].first;
+					const char* last = first + match[3].length();
+					auto [end, ec] = std::from_chars(first, last, value);
+					if (ec != std::errc() || end != last || value < 1 || value > 65535) {
+						return false;
+					}
+					port = static_cast<unsigned short>(value);
+				}
+				path = (match[4].matched && match[4].length() > 0) ? match[4].str() : "/";
+				if (match[5].matched) {
+					path += match[5].str(); // Keep the query string as part of the request target
+				}
+				return true;
+			}
+			return false;
+		}
+
+		// Converts a proxy URL to the "host:port" form WinHttpOpen takes; false unless
+		// the URL is http://host[:port]
+		inline bool parseProxyUrl(const std::string& url, std::string& hostPort) {
+			std::string scheme, host, path;
+			unsigned short port;
+			if (!parseUrl(url, scheme, host, port, path) || scheme != "http") {
+				return false;
+			}
+			hostPort = host + ":" + std::to_string(port);
+			return true;
+		}
+
+		// Closes a request handle from another thread when its deadline passes (via the timer
+		// wheel) or its stop token is triggered, which makes the WinHTTP call blocked on it
+		// fail. On destruction the watch is disarmed; if it already fired, the handle is
+		// released so its owner does not close it again.
+		class RequestWatch {
+		public:
+			enum class Reason { None, Deadline, Stopped };
+
+			RequestWatch(WinHttpHandle& request, std::optional<std::chrono::steady_clock::time_point> deadline,
+				const std::stop_token& stop)
+				: request_(request), state_(std::make_shared<State>()) {
+				state_->handle = request.get();
+				if (deadline) {
+					timer_ = TimerWheel::shared().schedule(*deadline, [state = state_]() { trip(*state, Reason::Deadline); });
+				}
+				if (stop.stop_possible()) {
+					// Runs at once if the stop was already requested
+					stop_callback_.emplace(stop, [state = state_]() { trip(*state, Reason::Stopped); });
+				}
+			}
+
+			~RequestWatch() {
+				if (timer_) {
+					TimerWheel::shared().cancel(timer_);
+				}
+				stop_callback_.reset(); // Waits for a callback already running on another thread
+				std::lock_guard<std::mutex> lock(state_->mutex);
+				state_->handle = nullptr;
+				if (state_->reason != Reason::None) {
+					request_.release();
+				}
+			}
+
+			RequestWatch(const RequestWatch&) = delete;
+			RequestWatch& operator=(const RequestWatch&) = delete;
+
+			// Why the handle was closed, or None while the request is still the owner's
+			Reason reason() const {
+				std::lock_guard<std::mutex> lock(state_->mutex);
+				return state_->reason;
+			}
+
+		private:
+			struct State {
+				std::mutex mutex;
+				HINTERNET handle = nullptr;
+				Reason reason = Reason::None;
+			};
+
+			static void trip(State& state, Reason reason) {
+				std::lock_guard<std::mutex> lock(state.mutex);
+				if (state.handle) {
+					WinHttpCloseHandle(state.handle);
+					state.handle = nullptr;
+					state.reason = reason;
+				}
+			}
+
+			WinHttpHandle& request_;
+			std::shared_ptr<State> state_;
+			uint64_t timer_ = 0;
+			std::optional<std::stop_callback<std::function<void()>>> stop_callback_;
+		};
+
+	} // namespace detail
+
 	// Represents an HTTP response
 	class HttpResponse {
 	public:
-		HttpResponse() : status_code(0) {}
+		HttpResponse() : status_code(0), error_kind(ErrorKind::None), attempts(0), from_cache(false) {}
 
 		int status_code;
 		std::string body;
 		std::unordered_map<std::string, std::string> headers;
+		std::vector<std::string> set_cookies; // Every Set-Cookie header; headers keeps only the last
 		std::string error;
+		ErrorKind error_kind;
+		int attempts; // Number of times the request was sent, including retries
+		bool from_cache; // Served or revalidated from the response cache
+		std::string url; // Final URL when redirects were followed, otherwise empty
+		std::string protocol; // "HTTP/2" or "HTTP/1.1" for responses received from the network
 
 		bool is_success() const {
 			return status_code >= 200 && status_code < 300 && error.empty();
 		}
 
+		// Returns the body without copying. With zero-copy bodies enabled, cached and
+		// coalesced responses keep their body in shared storage and leave `body` empty.
+		std::string_view bodyView() const {
+			return body_owner_ ? body_view_ : std::string_view(body);
+		}
+
+		// Points the body at external storage that owner keeps alive
+		void setBodyView(std::string_view view, std::shared_ptr<const void> owner) {
+			body_view_ = view;
+			body_owner_ = std::move(owner);
+		}
+
+		// Looks up a header by name, ignoring case; returns an empty string if absent
+		std::string getHeader(const std::string& name) const {
+			const std::string* value = detail::findHeader(headers, name);
+			return value ? *value : std::string();
+		}
+
 		// Parses headers from a raw header string
 		void parseHeaders(const std::string& raw_headers) {
 			headers.clear();
+			set_cookies.clear();
 			std::istringstream stream(raw_headers);
 			std::string line;
 			std::getline(stream, line); // Skip status line
@@ -89,12 +646,18 @@ namespace HttpClientLib {
 				if (delimiter_pos != std::string::npos) {
 					std::string key = trim(line.substr(0, delimiter_pos));
 					std::string value = trim(line.substr(delimiter_pos + 1));
+					if (detail::equalsIgnoreCase(key, "Set-Cookie")) {
+						set_cookies.push_back(value);
+					}
 					headers[key] = value;
 				}
 			}
 		}
 
 	private:
+		std::string_view body_view_;
+		std::shared_ptr<const void> body_owner_;
+
 		// Helper function to trim whitespace and carriage return
 		std::string trim(const std::string& str) const {
 			size_t first = str.find_first_not_of(" \t\r\n");
@@ -103,137 +666,4361 @@ namespace HttpClientLib {
 		}
 	};
 
-	// The main HttpClient class
-	class HttpClient {
-	public:
-		HttpClient(const std::string& userAgent = "HttpClient/1.0") : user_agent_(userAgent) {}
+	// Routes requests through an explicit HTTP proxy
+	struct ProxyOptions {
+		std::string url;                 // "http://proxy:8080"; empty uses the system proxy settings
+		std::vector<std::string> bypass; // Hosts reached directly, e.g. "*.corp.example" or "<local>"
+		std::string username;            // Sent when the proxy answers 407
+		std::string password;
+	};
 
-		HttpResponse get(const std::string& url, const std::unordered_map<std::string, std::string>& headers = {}) const {
-			return sendRequest("GET", url, "", headers);
-		}
+	// TLS settings for the shared session. WinHTTP's TLS layer (Schannel) keeps one
+	// credential handle and session cache per session, so all pooled connections share
+	// the trust store and resume earlier sessions with abbreviated handshakes, and h2 is
+	// negotiated through ALPN. Changing these settings opens a new session.
+	struct TlsOptions {
+		bool tls13 = true;             // Offer TLS 1.3 (one round trip fewer per handshake) where supported
+		bool allow_legacy = false;     // Also accept TLS 1.0 and 1.1 servers
+		bool verify_peer = true;       // false accepts any certificate, e.g. a local self-signed test server
+		bool check_revocation = false; // Check certificate revocation on each new connection
+		bool false_start = false;      // Send the request one flight early on full TLS 1.2 handshakes
+	};
 
-		HttpResponse post(const std::string& url, const std::string& data, const std::unordered_map<std::string, std::string>& headers = {}) const {
-			return sendRequest("POST", url, data, headers);
-		}
+	// TCP settings for the shared session's connections. WinHTTP owns its sockets and
+	// exposes only these options; everything else keeps the system defaults.
+	struct SocketOptions {
+		bool keepalive = false;                                // Probe idle pooled connections so dead peers are noticed
+		std::chrono::milliseconds keepalive_time{ 60000 };     // Idle time before the first probe
+		std::chrono::milliseconds keepalive_interval{ 1000 };  // Time between unanswered probes
+		bool fast_open = false;                                // TCP Fast Open: send the request in the SYN on repeat connects
+		int max_connections_per_server = 0;                    // Cap on connections per origin; 0 leaves it unlimited
+	};
 
-		HttpResponse put(const std::string& url, const std::string& data, const std::unordered_map<std::string, std::string>& headers = {}) const {
-			return sendRequest("PUT", url, data, headers);
+	// Shared WinHTTP session with one connect handle per origin.
+	// WinHTTP pools idle keep-alive connections per session, so requests that
+	// share the session reuse TCP/TLS connections instead of reconnecting.
+	// Behind a named proxy the same holds for proxy connections: plain HTTP is
+	// sent in absolute-form and HTTPS goes through a CONNECT tunnel that stays
+	// pooled for its target origin, so the proxy handshake is paid once per
+	// connection rather than once per request.
+	class ConnectionPool {
+	public:
+		// Throws std::invalid_argument if proxy.url is set but is not http://host[:port]
+		explicit ConnectionPool(const std::wstring& userAgent, ProxyOptions proxy = {}, bool http2 = true, TlsOptions tls = {},
+			SocketOptions socket = {})
+			: user_agent_(userAgent), proxy_(std::move(proxy)), http2_(http2), tls_(tls), socket_(socket) {
+			if (!proxy_.url.empty()) {
+				std::string hostPort;
+				if (!detail::parseProxyUrl(proxy_.url, hostPort)) {
+					throw std::invalid_argument("ProxyOptions::url must be of the form http://host[:port]");
+				}
+				// WinHTTP takes the proxy as "host:port" and the bypass list separated by semicolons
+				std::string bypass;
+				for (const auto& entry : proxy_.bypass) {
+					if (!bypass.empty()) bypass += ';';
+					bypass += entry;
+				}
+				proxy_name_ = detail::toWideString(hostPort);
+				proxy_bypass_ = detail::toWideString(bypass);
+			}
 		}
 
-		HttpResponse patch(const std::string& url, const std::string& data, const std::unordered_map<std::string, std::string>& headers = {}) const {
-			return sendRequest("PATCH", url, data, headers);
-		}
+		// Disable copy
+		ConnectionPool(const ConnectionPool&) = delete;
+		ConnectionPool& operator=(const ConnectionPool&) = delete;
 
-		HttpResponse del(const std::string& url, const std::unordered_map<std::string, std::string>& headers = {}) const {
-			return sendRequest("DELETE", url, "", headers);
+		// Returns the session handle, opening it on first use; nullptr on failure
+		HINTERNET session() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return sessionLocked();
 		}
 
-		HttpResponse head(const std::string& url, const std::unordered_map<std::string, std::string>& headers = {}) const {
-			return sendRequest("HEAD", url, "", headers);
+		// Returns the connect handle for host:port; nullptr on failure
+		HINTERNET connect(const std::wstring& host, unsigned short port) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			std::wstring key = host + L":" + std::to_wstring(port);
+			auto it = connections_.find(key);
+			if (it != connections_.end()) {
+				return it->second.get();
+			}
+			HINTERNET hSession = sessionLocked();
+			if (!hSession) {
+				return nullptr;
+			}
+			WinHttpHandle hConnect(WinHttpConnect(hSession, host.c_str(), port, 0));
+			if (!hConnect.get()) {
+				return nullptr;
+			}
+			HINTERNET handle = hConnect.get();
+			connections_.emplace(key, std::move(hConnect));
+			return handle;
 		}
 
-		HttpResponse options(const std::string& url, const std::unordered_map<std::string, std::string>& headers = {}) const {
-			return sendRequest("OPTIONS", url, "", headers);
-		}
+		const ProxyOptions& proxy() const { return proxy_; }
+		bool http2() const { return http2_; }
+		const TlsOptions& tls() const { return tls_; }
+		const SocketOptions& socket() const { return socket_; }
 
-		// Sends a POST request with JSON data
-		HttpResponse postJson(const std::string& url, const nlohmann::json& jsonData,
-			const std::unordered_map<std::string, std::string>& headers = {}) const {
-			std::string data = jsonData.dump();
-			auto headersWithContentType = headers;
-			headersWithContentType["Content-Type"] = "application/json";
-			return sendRequest("POST", url, data, headersWithContentType);
+	private:
+		HINTERNET sessionLocked() {
+			if (!session_.get()) {
+				if (proxy_.url.empty()) {
+					session_.reset(WinHttpOpen(
+						user_agent_.c_str(),
+						WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+						WINHTTP_NO_PROXY_NAME,
+						WINHTTP_NO_PROXY_BYPASS, 0));
+				}
+				else {
+					session_.reset(WinHttpOpen(
+						user_agent_.c_str(),
+						WINHTTP_ACCESS_TYPE_NAMED_PROXY,
+						proxy_name_.c_str(),
+						proxy_bypass_.empty() ? WINHTTP_NO_PROXY_BYPASS : proxy_bypass_.c_str(), 0));
+				}
+#ifdef WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL
+				if (session_.get() && http2_) {
+					// Offer h2 through ALPN. WinHTTP then multiplexes concurrent requests to an
+					// origin as streams over one connection and falls back to HTTP/1.1 on its
+					// own. Systems older than Windows 10 1607 reject the option and stay on 1.1.
+					DWORD protocols = WINHTTP_PROTOCOL_FLAG_HTTP2;
+					WinHttpSetOption(session_.get(), WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &protocols, sizeof(protocols));
+				}
+#endif
+				if (session_.get()) {
+					// An explicit protocol set avoids handshakes with versions that would be refused
+					// or downgraded. Systems without TLS 1.3 reject its flag, so retry without it.
+					DWORD protocols = WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_2;
+					if (tls_.allow_legacy) {
+						protocols |= WINHTTP_FLAG_SECURE_PROTOCOL_TLS1 | WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_1;
+					}
+#ifdef WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_3
+					if (tls_.tls13) {
+						DWORD withTls13 = protocols | WINHTTP_FLAG_SECURE_PROTOCOL_TLS1_3;
+						if (WinHttpSetOption(session_.get(), WINHTTP_OPTION_SECURE_PROTOCOLS, &withTls13, sizeof(withTls13))) {
+							protocols = 0;
+						}
+					}
+#endif
+					if (protocols) {
+						WinHttpSetOption(session_.get(), WINHTTP_OPTION_SECURE_PROTOCOLS, &protocols, sizeof(protocols));
+					}
+#ifdef WINHTTP_OPTION_TLS_FALSE_START
+					if (tls_.false_start) {
+						// Schannel only false-starts with forward-secret AEAD suites and falls back to a
+						// normal handshake otherwise. Unlike 0-RTT early data, a false-started request
+						// cannot be replayed, so it is safe for every method.
+						BOOL enable = TRUE;
+						WinHttpSetOption(session_.get(), WINHTTP_OPTION_TLS_FALSE_START, &enable, sizeof(enable));
+					}
+#endif
+#ifdef WINHTTP_OPTION_TCP_KEEPALIVE
+					if (socket_.keepalive) {
+						// Same layout as tcp_keepalive from <mstcpip.h>, which needs Winsock headers
+						struct {
+							ULONG onoff;
+							ULONG keepalivetime;
+							ULONG keepaliveinterval;
+						} keepalive = { 1, static_cast<ULONG>(socket_.keepalive_time.count()),
+							static_cast<ULONG>(socket_.keepalive_interval.count()) };
+						WinHttpSetOption(session_.get(), WINHTTP_OPTION_TCP_KEEPALIVE, &keepalive, sizeof(keepalive));
+					}
+#endif
+#ifdef WINHTTP_OPTION_TCP_FAST_OPEN
+					if (socket_.fast_open) {
+						BOOL enable = TRUE;
+						WinHttpSetOption(session_.get(), WINHTTP_OPTION_TCP_FAST_OPEN, &enable, sizeof(enable));
+					}
+#endif
+					if (socket_.max_connections_per_server > 0) {
+						// Requests beyond the cap wait for a pooled connection instead of opening a
+						// socket that would later sit in TIME_WAIT holding an ephemeral port
+						DWORD maxConnections = static_cast<DWORD>(socket_.max_connections_per_server);
+						WinHttpSetOption(session_.get(), WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &maxConnections, sizeof(maxConnections));
+						WinHttpSetOption(session_.get(), WINHTTP_OPTION_MAX_CONNS_PER_1_0_SERVER, &maxConnections, sizeof(maxConnections));
+					}
+				}
+			}
+			return session_.get();
 		}
 
-	private:
-		std::string user_agent_;
+		std::wstring user_agent_;
+		ProxyOptions proxy_;
+		std::wstring proxy_name_;   // "host:port" as WinHttpOpen takes it
+		std::wstring proxy_bypass_;
+		bool http2_;
+		TlsOptions tls_;
+		SocketOptions socket_;
+		std::mutex mutex_;
+		// Declared after session_ so connect handles are closed first
+		WinHttpHandle session_;
+		std::unordered_map<std::wstring, WinHttpHandle> connections_;
+	};
 
-		// Converts UTF-8 string to wide string (UTF-16)
-		std::wstring toWideString(const std::string& utf8Str) const {
-			if (utf8Str.empty()) return std::wstring();
-			int size_needed = MultiByteToWideChar(CP_UTF8, 0, utf8Str.c_str(), static_cast<int>(utf8Str.length()), NULL, 0);
-			if (size_needed == 0) {
-				throw std::runtime_error("Failed to convert string to wide string.");
-			}
-			std::wstring wideStr(size_needed, 0);
-			MultiByteToWideChar(CP_UTF8, 0, utf8Str.c_str(), static_cast<int>(utf8Str.length()), &wideStr[0], size_needed);
-			// Remove the null terminator added by MultiByteToWideChar
-			if (!wideStr.empty() && wideStr.back() == L'\0') {
-				wideStr.pop_back();
-			}
-			return wideStr;
+	// Per-phase timeouts. A zero phase keeps WinHTTP's default for it.
+	struct TimeoutPolicy {
+		std::chrono::milliseconds connect{ 0 };       // Name resolution and TCP connect, each
+		std::chrono::milliseconds tls_handshake{ 0 }; // TLS handshake; WinHTTP also applies it to each request send
+		std::chrono::milliseconds first_byte{ 0 };    // From the request being sent until the response headers arrive
+		std::chrono::milliseconds read_idle{ 0 };     // Longest wait for any single body read
+		std::chrono::milliseconds total{ 0 };         // Whole call including redirects and retries; 0 is unlimited
+	};
+
+	// Applies a timeout policy and/or an absolute deadline to every request the current
+	// thread makes while the scope is alive. Scopes nest: the innermost policy applies and
+	// the earliest deadline wins, so an upstream budget carries through a call chain.
+	class TimeoutScope {
+	public:
+		explicit TimeoutScope(std::chrono::steady_clock::time_point deadline)
+			: saved_(current()) {
+			current().deadline = saved_.deadline ? (std::min)(*saved_.deadline, deadline) : deadline;
 		}
 
-		// Converts wide string (UTF-16) to UTF-8 string
-		std::string toUTF8String(const std::wstring& wideStr) const {
-			if (wideStr.empty()) return std::string();
-			int size_needed = WideCharToMultiByte(CP_UTF8, 0, wideStr.c_str(), static_cast<int>(wideStr.length()), NULL, 0, NULL, NULL);
-			if (size_needed == 0) {
-				throw std::runtime_error("Failed to convert wide string to UTF-8 string.");
+		explicit TimeoutScope(std::chrono::milliseconds budget)
+			: TimeoutScope(std::chrono::steady_clock::now() + budget) {}
+
+		explicit TimeoutScope(const TimeoutPolicy& policy,
+			std::optional<std::chrono::steady_clock::time_point> deadline = std::nullopt)
+			: saved_(current()), policy_(policy) {
+			current().policy = &policy_;
+			if (deadline) {
+				current().deadline = saved_.deadline ? (std::min)(*saved_.deadline, *deadline) : *deadline;
 			}
-			std::string utf8Str(size_needed, 0);
-			WideCharToMultiByte(CP_UTF8, 0, wideStr.c_str(), static_cast<int>(wideStr.length()), &utf8Str[0], size_needed, NULL, NULL);
-			return utf8Str;
 		}
 
-		// Parses the URL into scheme, host, port, and path
-		bool parseUrl(const std::string& url, std::string& scheme, std::string& host,
-			unsigned short& port, std::string& path) const {
-			std::regex urlRegex(R"((https?)://([^/:]+)(?::(\d+))?([^?]*)?(\?.*)?$)");
-			std::smatch match;
-			if (std::regex_match(url, match, urlRegex)) {
-				scheme = match[1].str();
-				host = match[2].str();
-				port = match[3].matched ? static_cast<unsigned short>(std::stoi(match[3].str()))
-					: (scheme == "https" ? 443 : 80);
-				path = match[4].matched ? match[4].str() : "/";
-				return true;
-			}
-			return false;
+		~TimeoutScope() { current() = saved_; }
+
+		TimeoutScope(const TimeoutScope&) = delete;
+		TimeoutScope& operator=(const TimeoutScope&) = delete;
+
+		// The innermost policy in effect on this thread, or nullptr for the client's own
+		static const TimeoutPolicy* policy() { return current().policy; }
+
+		// The earliest deadline in effect on this thread
+		static std::optional<std::chrono::steady_clock::time_point> deadline() { return current().deadline; }
+
+		// Time left before the deadline (zero once it has passed); nullopt without a deadline
+		static std::optional<std::chrono::milliseconds> remaining() {
+			auto until = current().deadline;
+			if (!until) return std::nullopt;
+			auto left = std::chrono::duration_cast<std::chrono::milliseconds>(*until - std::chrono::steady_clock::now());
+			return (std::max)(left, std::chrono::milliseconds{ 0 });
 		}
 
-		// Sends an HTTP request
-		HttpResponse sendRequest(const std::string& method, const std::string& url,
-			const std::string& data,
-			const std::unordered_map<std::string, std::string>& headers) const {
-			HttpResponse response;
-			try {
-				std::string scheme, host, path;
-				unsigned short port;
-				if (!parseUrl(url, scheme, host, port, path)) {
-					response.error = "Invalid URL format.";
-					return response;
-				}
+	private:
+		struct State {
+			const TimeoutPolicy* policy = nullptr;
+			std::optional<std::chrono::steady_clock::time_point> deadline;
+		};
 
-				bool isHttps = (scheme == "https");
+		static State& current() {
+			thread_local State state;
+			return state;
+		}
 
-				// Initialize WinHTTP session
-				WinHttpHandle hSession(WinHttpOpen(
-					toWideString(user_agent_).c_str(),
-					WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-					WINHTTP_NO_PROXY_NAME,
-					WINHTTP_NO_PROXY_BYPASS, 0));
+		State saved_;
+		TimeoutPolicy policy_;
+	};
 
-				if (!hSession.get()) {
-					response.error = "WinHttpOpen failed.";
-					return response;
-				}
+	// Controls automatic retries of failed idempotent requests
+	struct RetryPolicy {
+		int max_attempts = 1; // Total attempts including the first; 1 disables retries
+		std::vector<int> retry_status_codes = { 429, 502, 503, 504 };
+		std::chrono::milliseconds base_delay{ 100 };
+		std::chrono::milliseconds max_delay{ 10000 };
+		bool honor_retry_after = true;
+		std::chrono::milliseconds max_retry_after{ 30000 }; // Longer Retry-After values end retrying
 
-				// Connect to server
-				WinHttpHandle hConnect(WinHttpConnect(
-					hSession.get(),
-					toWideString(host).c_str(),
-					port,
-					0));
+		// Per-host retry budget: each request earns budget_ratio tokens, each retry
+		// spends one, and the bucket also refills at budget_refill_per_second
+		double budget_ratio = 0.1;
+		double budget_refill_per_second = 1.0;
+		double budget_capacity = 10.0;
+	};
 
-				if (!hConnect.get()) {
-					response.error = "WinHttpConnect failed.";
-					return response;
-				}
+	// Token bucket limiting how many retries a single host may receive
+	class RetryBudget {
+	public:
+		RetryBudget(double capacity, double ratio, double refillPerSecond)
+			: capacity_(capacity), ratio_(ratio), refill_per_second_(refillPerSecond),
+			tokens_(capacity), last_refill_(std::chrono::steady_clock::now()) {}
+
+		// Credits the bucket for an original (non-retry) request
+		void deposit() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			refillLocked();
+			tokens_ = (std::min)(capacity_, tokens_ + ratio_);
+		}
+
+		// Takes one token for a retry; returns false when the budget is spent
+		bool tryWithdraw() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			refillLocked();
+			if (tokens_ < 1.0) {
+				return false;
+			}
+			tokens_ -= 1.0;
+			return true;
+		}
+
+	private:
+		void refillLocked() {
+			auto now = std::chrono::steady_clock::now();
+			std::chrono::duration<double> elapsed = now - last_refill_;
+			last_refill_ = now;
+			tokens_ = (std::min)(capacity_, tokens_ + elapsed.count() * refill_per_second_);
+		}
+
+		double capacity_;
+		double ratio_;
+		double refill_per_second_;
+		double tokens_;
+		std::chrono::steady_clock::time_point last_refill_;
+		std::mutex mutex_;
+	};
+
+	// Retry budgets keyed by host
+	class RetryBudgets {
+	public:
+		std::shared_ptr<RetryBudget> forHost(const std::string& host, const RetryPolicy& policy) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto& budget = budgets_[host];
+			if (!budget) {
+				budget = std::make_shared<RetryBudget>(policy.budget_capacity, policy.budget_ratio,
+					policy.budget_refill_per_second);
+			}
+			return budget;
+		}
+
+	private:
+		std::mutex mutex_;
+		std::unordered_map<std::string, std::shared_ptr<RetryBudget>> budgets_;
+	};
+
+	// States of a per-host circuit breaker
+	enum class CircuitState { Closed, Open, HalfOpen };
+
+	// Controls when a host's circuit breaker trips and recovers
+	struct CircuitBreakerPolicy {
+		bool enabled = false;
+		std::chrono::milliseconds window{ 10000 }; // Rolling window for error and latency rates
+		int window_buckets = 10;
+		int minimum_calls = 20;                    // Calls in the window before rates are evaluated
+		double failure_rate_threshold = 0.5;       // Transport errors and 5xx responses
+		std::chrono::milliseconds slow_call_duration{ 0 }; // 0 disables latency-based tripping
+		double slow_call_rate_threshold = 0.8;
+		std::chrono::milliseconds open_duration{ 5000 };   // Time spent open before probing
+		int half_open_max_probes = 1;              // Concurrent probes allowed while half-open
+	};
+
+	// Point-in-time view of one origin, as returned by HttpClient::metrics()
+	struct HostMetrics {
+		CircuitState circuit_state = CircuitState::Closed;
+		double failure_rate = 0.0;
+		double slow_call_rate = 0.0;
+		unsigned long long calls_in_window = 0;
+		unsigned long long rejected_calls = 0;     // Fast-failed while open or half-open
+		int concurrency_limit = 0;                 // Current adaptive limit; 0 when limiting is off
+		int in_flight = 0;
+		unsigned long long shed_calls = 0;         // Rejected because the limit was reached
+	};
+
+	// Closed/open/half-open breaker driven by a bucketed rolling window
+	class CircuitBreaker {
+	public:
+		explicit CircuitBreaker(const CircuitBreakerPolicy& policy)
+			: policy_(policy), buckets_((std::max)(1, policy.window_buckets)) {}
+
+		// Returns true if a call may proceed. A half-open probe gets the round it belongs to
+		// in probe (0 for ordinary calls), so a late result from an earlier round is ignored.
+		bool tryAcquire(uint64_t& probe) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			probe = 0;
+			auto now = std::chrono::steady_clock::now();
+			if (state_ == CircuitState::Open) {
+				if (now - opened_at_ < policy_.open_duration) {
+					++rejected_;
+					return false;
+				}
+				state_ = CircuitState::HalfOpen;
+				++round_;
+				probes_in_flight_ = 0;
+				probe_successes_ = 0;
+			}
+			if (state_ == CircuitState::HalfOpen) {
+				if (probes_in_flight_ >= (std::max)(1, policy_.half_open_max_probes)) {
+					++rejected_;
+					return false;
+				}
+				++probes_in_flight_;
+				probe = round_;
+			}
+			return true;
+		}
+
+		// Records the outcome of a call admitted by tryAcquire
+		void onResult(bool failed, std::chrono::steady_clock::duration latency, uint64_t probe) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto now = std::chrono::steady_clock::now();
+			bool slow = policy_.slow_call_duration.count() > 0 && latency >= policy_.slow_call_duration;
+
+			if (probe) {
+				if (!currentProbeLocked(probe)) return; // Its round already ended
+				--probes_in_flight_;
+				if (failed || slow) {
+					tripLocked(now);
+				}
+				else if (++probe_successes_ >= (std::max)(1, policy_.half_open_max_probes)) {
+					state_ = CircuitState::Closed;
+					for (auto& bucket : buckets_) bucket = Bucket();
+				}
+				return;
+			}
+
+			Bucket& bucket = bucketLocked(now);
+			++bucket.calls;
+			if (failed) ++bucket.failures;
+			if (slow) ++bucket.slow;
+
+			if (state_ == CircuitState::Closed) {
+				Bucket total = totalsLocked(now);
+				if (total.calls >= static_cast<unsigned long long>(policy_.minimum_calls) &&
+					(ratio(total.failures, total.calls) >= policy_.failure_rate_threshold ||
+						(policy_.slow_call_duration.count() > 0 &&
+							ratio(total.slow, total.calls) >= policy_.slow_call_rate_threshold))) {
+					tripLocked(now);
+				}
+			}
+		}
+
+		// Releases a permit without recording an outcome, e.g. when the call was shed
+		void abandon(uint64_t probe) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (probe && currentProbeLocked(probe)) --probes_in_flight_;
+		}
+
+		void fillMetrics(HostMetrics& metrics) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto now = std::chrono::steady_clock::now();
+			if (state_ == CircuitState::Open && now - opened_at_ >= policy_.open_duration) {
+				metrics.circuit_state = CircuitState::HalfOpen;
+			}
+			else {
+				metrics.circuit_state = state_;
+			}
+			Bucket total = totalsLocked(now);
+			metrics.calls_in_window = total.calls;
+			metrics.failure_rate = ratio(total.failures, total.calls);
+			metrics.slow_call_rate = ratio(total.slow, total.calls);
+			metrics.rejected_calls = rejected_;
+		}
+
+	private:
+		struct Bucket {
+			long long epoch = -1;
+			unsigned long long calls = 0;
+			unsigned long long failures = 0;
+			unsigned long long slow = 0;
+		};
+
+		static double ratio(unsigned long long part, unsigned long long whole) {
+			return whole == 0 ? 0.0 : static_cast<double>(part) / static_cast<double>(whole);
+		}
+
+		long long epochOf(std::chrono::steady_clock::time_point now) const {
+			auto width = (std::max<long long>)(1, policy_.window.count() / static_cast<long long>(buckets_.size()));
+			return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch()).count() / width;
+		}
+
+		Bucket& bucketLocked(std::chrono::steady_clock::time_point now) {
+			long long epoch = epochOf(now);
+			Bucket& bucket = buckets_[static_cast<size_t>(epoch % static_cast<long long>(buckets_.size()))];
+			if (bucket.epoch != epoch) {
+				bucket = Bucket();
+				bucket.epoch = epoch;
+			}
+			return bucket;
+		}
+
+		Bucket totalsLocked(std::chrono::steady_clock::time_point now) const {
+			long long epoch = epochOf(now);
+			Bucket total;
+			for (const auto& bucket : buckets_) {
+				if (bucket.epoch >= 0 && epoch - bucket.epoch < static_cast<long long>(buckets_.size())) {
+					total.calls += bucket.calls;
+					total.failures += bucket.failures;
+					total.slow += bucket.slow;
+				}
+			}
+			return total;
+		}
+
+		void tripLocked(std::chrono::steady_clock::time_point now) {
+			state_ = CircuitState::Open;
+			opened_at_ = now;
+		}
+
+		bool currentProbeLocked(uint64_t probe) const {
+			return state_ == CircuitState::HalfOpen && probe == round_;
+		}
+
+		CircuitBreakerPolicy policy_;
+		std::vector<Bucket> buckets_;
+		CircuitState state_ = CircuitState::Closed;
+		std::chrono::steady_clock::time_point opened_at_;
+		uint64_t round_ = 0; // Half-open rounds started so far
+		int probes_in_flight_ = 0;
+		int probe_successes_ = 0;
+		unsigned long long rejected_ = 0;
+		std::mutex mutex_;
+	};
+
+	// Circuit breakers keyed by origin ("host:port"), so services sharing a host fail independently
+	class CircuitBreakers {
+	public:
+		explicit CircuitBreakers(const CircuitBreakerPolicy& policy) : policy_(policy) {}
+
+		std::shared_ptr<CircuitBreaker> forOrigin(const std::string& origin) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto& breaker = breakers_[origin];
+			if (!breaker) {
+				breaker = std::make_shared<CircuitBreaker>(policy_);
+			}
+			return breaker;
+		}
+
+		void fillMetrics(std::unordered_map<std::string, HostMetrics>& metrics) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (const auto& [origin, breaker] : breakers_) {
+				breaker->fillMetrics(metrics[origin]);
+			}
+		}
+
+	private:
+		CircuitBreakerPolicy policy_;
+		std::mutex mutex_;
+		std::unordered_map<std::string, std::shared_ptr<CircuitBreaker>> breakers_;
+	};
+
+	// Controls the per-host adaptive concurrency limiter
+	struct ConcurrencyLimitPolicy {
+		bool enabled = false;
+		int initial_limit = 20;
+		int min_limit = 1;
+		int max_limit = 1000;
+		double backoff_ratio = 0.9;        // Multiplicative decrease on errors, 429 and 503
+		int min_rtt_reset_samples = 1000;  // Re-learn the no-load RTT after this many samples
+		std::chrono::milliseconds queue_timeout{ 0 }; // How long excess requests wait; 0 sheds immediately
+		int max_queued = 100;              // Waiting requests beyond this are shed
+	};
+
+	// Vegas-style limiter: grows the limit while measured RTT stays near the
+	// no-load RTT, shrinks it as queueing delay builds, and backs off
+	// multiplicatively (AIMD) when the host reports errors or overload
+	class ConcurrencyLimiter {
+	public:
+		explicit ConcurrencyLimiter(const ConcurrencyLimitPolicy& policy)
+			: policy_(policy),
+			limit_(std::clamp<double>(policy.initial_limit, (std::max)(1, policy.min_limit), (std::max)(1, policy.max_limit))) {}
+
+		// Waits up to queue_timeout for a slot, but never past the calling thread's deadline and
+		// not after a stop is requested. Returns None once admitted, Overloaded if the call is
+		// shed, or Timeout / Cancelled if the deadline or the stop token ended the wait.
+		ErrorKind acquire() {
+			std::unique_lock<std::mutex> lock(mutex_);
+			if (in_flight_ < currentLimitLocked()) {
+				++in_flight_;
+				return ErrorKind::None;
+			}
+			if (policy_.queue_timeout.count() <= 0 || queued_ >= policy_.max_queued) {
+				++shed_;
+				return ErrorKind::Overloaded;
+			}
+			auto until = std::chrono::steady_clock::now() + policy_.queue_timeout;
+			auto deadline = TimeoutScope::deadline();
+			bool deadlineFirst = deadline && *deadline < until;
+			if (deadlineFirst) {
+				until = *deadline;
+			}
+			const std::stop_token& stop = detail::StopScope::token();
+			++queued_;
+			bool admitted = slot_available_.wait_until(lock, stop, until,
+				[this] { return in_flight_ < currentLimitLocked(); });
+			--queued_;
+			if (admitted) {
+				++in_flight_;
+				return ErrorKind::None;
+			}
+			if (stop.stop_requested()) {
+				return ErrorKind::Cancelled;
+			}
+			if (deadlineFirst) {
+				return ErrorKind::Timeout;
+			}
+			++shed_;
+			return ErrorKind::Overloaded;
+		}
+
+		// Releases a slot without feeding a sample into the limit, e.g. for a cancelled call
+		void abandon() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			--in_flight_;
+			slot_available_.notify_all();
+		}
+
+		// Releases a slot and feeds the call's round-trip time into the limit
+		void release(std::chrono::steady_clock::duration rtt, bool dropped) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			int inFlight = in_flight_--;
+			double rttMs = std::chrono::duration<double, std::milli>(rtt).count();
+
+			if (++samples_ >= policy_.min_rtt_reset_samples) {
+				// Drain to half the limit so the re-learned RTT reflects a lightly loaded host
+				samples_ = 0;
+				min_rtt_ms_ = 0.0;
+				limit_ /= 2.0;
+			}
+
+			if (dropped) {
+				limit_ *= policy_.backoff_ratio;
+			}
+			else if (rttMs > 0.0) {
+				if (min_rtt_ms_ <= 0.0 || rttMs < min_rtt_ms_) {
+					min_rtt_ms_ = rttMs;
+				}
+				// Estimated requests queued at the server, compared against log10-scaled thresholds
+				double step = (std::max)(1.0, std::log10(limit_));
+				double queue = limit_ * (1.0 - min_rtt_ms_ / rttMs);
+				if (queue > 6.0 * step) {
+					limit_ -= step;
+				}
+				else if (queue < 3.0 * step && inFlight * 2 >= static_cast<int>(limit_)) {
+					// Only grow when the current limit is actually being used
+					limit_ += step;
+				}
+			}
+			limit_ = std::clamp<double>(limit_, (std::max)(1, policy_.min_limit), (std::max)(1, policy_.max_limit));
+			slot_available_.notify_all();
+		}
+
+		void fillMetrics(HostMetrics& metrics) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			metrics.concurrency_limit = currentLimitLocked();
+			metrics.in_flight = in_flight_;
+			metrics.shed_calls = shed_;
+		}
+
+	private:
+		int currentLimitLocked() const { return static_cast<int>(limit_); }
+
+		ConcurrencyLimitPolicy policy_;
+		double limit_;
+		double min_rtt_ms_ = 0.0;
+		int in_flight_ = 0;
+		int queued_ = 0;
+		int samples_ = 0;
+		unsigned long long shed_ = 0;
+		std::mutex mutex_;
+		std::condition_variable_any slot_available_; // _any so a queued call can wake on its stop token
+	};
+
+	// Concurrency limiters keyed by origin ("host:port")
+	class ConcurrencyLimiters {
+	public:
+		explicit ConcurrencyLimiters(const ConcurrencyLimitPolicy& policy) : policy_(policy) {}
+
+		std::shared_ptr<ConcurrencyLimiter> forOrigin(const std::string& origin) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto& limiter = limiters_[origin];
+			if (!limiter) {
+				limiter = std::make_shared<ConcurrencyLimiter>(policy_);
+			}
+			return limiter;
+		}
+
+		void fillMetrics(std::unordered_map<std::string, HostMetrics>& metrics) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (const auto& [origin, limiter] : limiters_) {
+				limiter->fillMetrics(metrics[origin]);
+			}
+		}
+
+	private:
+		ConcurrencyLimitPolicy policy_;
+		std::mutex mutex_;
+		std::unordered_map<std::string, std::shared_ptr<ConcurrencyLimiter>> limiters_;
+	};
+
+	// How an endpoint group chooses between its two random candidates
+	enum class BalancingMode {
+		LeastOutstanding, // Fewer in-flight requests wins; EWMA latency breaks ties
+		PeakEwma          // Lower EWMA latency weighted by in-flight requests wins
+	};
+
+	// Controls balancing and health-based ejection within an endpoint group
+	struct EndpointGroupPolicy {
+		BalancingMode mode = BalancingMode::PeakEwma;
+		double ewma_alpha = 0.3;                   // Weight of the newest latency sample
+		int consecutive_failures_to_eject = 5;     // Transport errors or 5xx in a row
+		std::chrono::milliseconds ejection_duration{ 30000 };
+	};
+
+	// A logical host served by several interchangeable backends. Each request
+	// picks two random healthy backends and sends to the cheaper one
+	// (power of two choices). Every backend is a separate origin in the
+	// connection pool, so each keeps its own pooled connections.
+	class EndpointGroup {
+	public:
+		struct Backend {
+			std::string scheme;
+			std::string host;
+			unsigned short port = 0;
+			int outstanding = 0;
+			double ewma_ms = 0.0;
+			int consecutive_failures = 0;
+			std::chrono::steady_clock::time_point ejected_until;
+		};
+
+		EndpointGroup(std::vector<Backend> backends, const EndpointGroupPolicy& policy)
+			: policy_(policy), backends_(std::move(backends)) {}
+
+		// Chooses a backend and counts the request as outstanding on it
+		size_t acquire(Backend& chosen) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto now = std::chrono::steady_clock::now();
+			std::vector<size_t> healthy;
+			for (size_t i = 0; i < backends_.size(); ++i) {
+				if (backends_[i].ejected_until <= now) healthy.push_back(i);
+			}
+			if (healthy.empty()) {
+				// Every backend is ejected: fall back to the whole set rather than failing
+				for (size_t i = 0; i < backends_.size(); ++i) healthy.push_back(i);
+			}
+
+			size_t index = healthy[0];
+			if (healthy.size() > 1) {
+				std::uniform_int_distribution<size_t> dist(0, healthy.size() - 1);
+				size_t a = dist(detail::randomEngine());
+				size_t b = dist(detail::randomEngine());
+				while (b == a) b = dist(detail::randomEngine());
+				index = cheaperLocked(healthy[a], healthy[b]);
+			}
+			++backends_[index].outstanding;
+			chosen = backends_[index];
+			return index;
+		}
+
+		// Records the outcome of a request sent to the backend returned by acquire
+		// latency is empty when the request never reached the network
+		void release(size_t index, bool failed, std::optional<std::chrono::steady_clock::duration> latency) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			Backend& backend = backends_[index];
+			--backend.outstanding;
+			if (latency) {
+				double sample = std::chrono::duration<double, std::milli>(*latency).count();
+				backend.ewma_ms = backend.ewma_ms == 0.0 ? sample
+					: policy_.ewma_alpha * sample + (1.0 - policy_.ewma_alpha) * backend.ewma_ms;
+			}
+			if (!failed) {
+				backend.consecutive_failures = 0;
+			}
+			else if (++backend.consecutive_failures >= policy_.consecutive_failures_to_eject) {
+				backend.consecutive_failures = 0;
+				backend.ejected_until = std::chrono::steady_clock::now() + policy_.ejection_duration;
+			}
+		}
+
+		// Releases a backend without judging it, e.g. for a locally rejected or cancelled request
+		void abandon(size_t index) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			--backends_[index].outstanding;
+		}
+
+		// Returns a copy of the backends and their current balancing state
+		std::vector<Backend> backends() const {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return backends_;
+		}
+
+	private:
+		size_t cheaperLocked(size_t a, size_t b) const {
+			const Backend& x = backends_[a];
+			const Backend& y = backends_[b];
+			if (policy_.mode == BalancingMode::LeastOutstanding) {
+				if (x.outstanding != y.outstanding) return x.outstanding < y.outstanding ? a : b;
+				return x.ewma_ms <= y.ewma_ms ? a : b;
+			}
+			// Unmeasured backends are priced at the group's mean latency so they don't draw all traffic
+			double seed = meanEwmaLocked();
+			double costX = (x.ewma_ms == 0.0 ? seed : x.ewma_ms) * (x.outstanding + 1);
+			double costY = (y.ewma_ms == 0.0 ? seed : y.ewma_ms) * (y.outstanding + 1);
+			if (costX != costY) return costX < costY ? a : b;
+			return x.outstanding <= y.outstanding ? a : b;
+		}
+
+		double meanEwmaLocked() const {
+			double sum = 0.0;
+			size_t measured = 0;
+			for (const auto& backend : backends_) {
+				if (backend.ewma_ms == 0.0) continue;
+				sum += backend.ewma_ms;
+				++measured;
+			}
+			return measured == 0 ? 0.0 : sum / measured;
+		}
+
+		EndpointGroupPolicy policy_;
+		std::vector<Backend> backends_;
+		mutable std::mutex mutex_;
+	};
+
+	// Endpoint groups keyed by logical host name
+	class EndpointGroups {
+	public:
+		void add(const std::string& name, std::shared_ptr<EndpointGroup> group) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			groups_[name] = std::move(group);
+		}
+
+		void remove(const std::string& name) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			groups_.erase(name);
+		}
+
+		// Returns the group, or nullptr; the group stays alive for the caller even if it is removed
+		std::shared_ptr<EndpointGroup> find(const std::string& name) const {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = groups_.find(name);
+			return it == groups_.end() ? nullptr : it->second;
+		}
+
+	private:
+		mutable std::mutex mutex_;
+		std::unordered_map<std::string, std::shared_ptr<EndpointGroup>> groups_;
+	};
+
+	// Configuration for the persistent disk tier of the response cache
+	struct DiskCacheOptions {
+		std::string directory;                    // Empty disables the disk tier
+		size_t max_bytes = 1024 * 1024 * 1024;    // Oldest segments are dropped beyond this
+		size_t segment_bytes = 64 * 1024 * 1024;  // Size of each mapped segment file
+	};
+
+	// Configuration for the response cache
+	struct ResponseCacheOptions {
+		bool enabled = false;
+		size_t max_bytes = 64 * 1024 * 1024; // Split evenly across shards
+		size_t shard_count = 16;
+		bool tiny_lfu_admission = true;      // Reject newcomers that are rarer than the LRU victim
+		std::chrono::seconds max_heuristic_freshness{ 86400 };
+		DiskCacheOptions disk;               // Optional second tier that survives restarts
+		bool zero_copy = false;              // Hits expose the stored body through bodyView() and leave body empty
+	};
+
+	// Counters reported by HttpClient::cacheStats()
+	struct ResponseCacheStats {
+		unsigned long long hits = 0;
+		unsigned long long misses = 0;
+		unsigned long long revalidations = 0; // Stale entries confirmed by a 304
+		unsigned long long stores = 0;
+		unsigned long long evictions = 0;
+		unsigned long long admissions_rejected = 0;
+		size_t entries = 0;
+		size_t bytes = 0;
+		unsigned long long disk_hits = 0;     // Memory misses served by the disk tier
+		size_t disk_entries = 0;
+		size_t disk_bytes = 0;                // Size of all mapped segments
+	};
+
+	// A stored response plus the RFC 9111 metadata needed to judge its freshness
+	struct CacheEntry {
+		int status_code = 0;
+		std::unordered_map<std::string, std::string> headers;
+		std::string_view body;                   // Points into body_owner
+		std::shared_ptr<const void> body_owner;  // A std::string, or a disk cache segment mapping
+		// Request headers named by Vary, lowercase name -> value (nullopt if absent)
+		std::vector<std::pair<std::string, std::optional<std::string>>> vary;
+		std::chrono::system_clock::time_point response_time;
+		std::chrono::seconds corrected_initial_age{ 0 };
+		std::chrono::seconds freshness_lifetime{ 0 };
+		bool must_revalidate_each_use = false; // Cache-Control: no-cache
+		std::string etag;
+		std::string last_modified;
+		size_t charge = 0;
+
+		std::chrono::seconds currentAge(std::chrono::system_clock::time_point now) const {
+			auto resident = std::chrono::duration_cast<std::chrono::seconds>(now - response_time);
+			return corrected_initial_age + (std::max)(resident, std::chrono::seconds{ 0 });
+		}
+
+		bool isFresh(std::chrono::system_clock::time_point now) const {
+			return !must_revalidate_each_use && freshness_lifetime > currentAge(now);
+		}
+
+		bool hasValidator() const { return !etag.empty() || !last_modified.empty(); }
+
+		// True if the request carries the same values for every header named by Vary
+		bool varyMatches(const std::unordered_map<std::string, std::string>& requestHeaders) const {
+			for (const auto& [name, expected] : vary) {
+				const std::string* value = detail::findHeader(requestHeaders, name);
+				if (value ? (!expected || *expected != *value) : expected.has_value()) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		void updateCharge() {
+			charge = body.size() + 256;
+			for (const auto& [key, value] : headers) {
+				charge += key.size() + value.size() + 64;
+			}
+		}
+	};
+
+	// One memory-mapped segment file of the disk cache. The mapping stays valid
+	// for as long as any response body view holds a reference to the segment.
+	class MappedSegment {
+	public:
+		MappedSegment(const std::filesystem::path& path, size_t minimumSize) : path_(path) {
+			file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ | GENERIC_WRITE,
+				FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (file_ == INVALID_HANDLE_VALUE) {
+				throw std::runtime_error("Failed to open cache segment " + path.string() + ".");
+			}
+			LARGE_INTEGER size;
+			if (!GetFileSizeEx(file_, &size)) {
+				release();
+				throw std::runtime_error("Failed to query cache segment size.");
+			}
+			if (static_cast<uint64_t>(size.QuadPart) < minimumSize) {
+				size.QuadPart = static_cast<LONGLONG>(minimumSize);
+				if (!SetFilePointerEx(file_, size, NULL, FILE_BEGIN) || !SetEndOfFile(file_)) {
+					release();
+					throw std::runtime_error("Failed to extend cache segment.");
+				}
+			}
+			size_ = static_cast<size_t>(size.QuadPart);
+			uint64_t size64 = size_;
+			mapping_ = CreateFileMappingW(file_, NULL, PAGE_READWRITE,
+				static_cast<DWORD>(size64 >> 32), static_cast<DWORD>(size64 & 0xFFFFFFFF), NULL);
+			if (mapping_) {
+				data_ = static_cast<char*>(MapViewOfFile(mapping_, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, size_));
+			}
+			if (!data_) {
+				release();
+				throw std::runtime_error("Failed to map cache segment.");
+			}
+		}
+
+		~MappedSegment() {
+			release();
+			if (remove_on_close_) {
+				std::error_code ec;
+				std::filesystem::remove(path_, ec);
+			}
+		}
+
+		// Disable copy
+		MappedSegment(const MappedSegment&) = delete;
+		MappedSegment& operator=(const MappedSegment&) = delete;
+
+		char* data() const { return data_; }
+		size_t size() const { return size_; }
+
+		// Deletes the file once the last reference (including body views) is gone
+		void removeOnClose() { remove_on_close_ = true; }
+
+		// Writes the range's dirty pages to the file, so a stored record survives a system crash
+		void flush(size_t offset, size_t size) const { FlushViewOfFile(data_ + offset, size); }
+
+	private:
+		void release() {
+			if (data_) UnmapViewOfFile(data_);
+			if (mapping_) CloseHandle(mapping_);
+			if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+			data_ = nullptr;
+			mapping_ = nullptr;
+			file_ = INVALID_HANDLE_VALUE;
+		}
+
+		std::filesystem::path path_;
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+		HANDLE mapping_ = nullptr;
+		char* data_ = nullptr;
+		size_t size_ = 0;
+		bool remove_on_close_ = false;
+	};
+
+	// Persistent cache tier: an append-only log of checksummed records spread
+	// over fixed-size memory-mapped segments, with an in-memory index from key
+	// hash to record location. The index is rebuilt by scanning the segments on
+	// startup; a torn record at the tail of the last segment ends the scan.
+	// Eviction drops whole segments, oldest first.
+	class DiskCache {
+	public:
+		// Throws if the directory cannot be created or another DiskCache already uses it
+		explicit DiskCache(const DiskCacheOptions& options)
+			: options_(options), directory_(detail::pathFromUtf8(options.directory)) {
+			options_.segment_bytes = std::clamp<size_t>(options_.segment_bytes, 64 * 1024, 0xFFFFFFFFu);
+			std::filesystem::create_directories(directory_);
+			// Two caches appending to the same segments would corrupt each other, so the
+			// directory is claimed with a lock file that is opened without sharing
+			lock_ = CreateFileW((directory_ / "cache.lock").wstring().c_str(), GENERIC_READ | GENERIC_WRITE,
+				0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (lock_ == INVALID_HANDLE_VALUE) {
+				throw std::runtime_error(GetLastError() == ERROR_SHARING_VIOLATION
+					? "Disk cache directory " + options.directory + " is already in use."
+					: "Failed to lock disk cache directory " + options.directory + ".");
+			}
+			try {
+				recover();
+			}
+			catch (...) {
+				CloseHandle(lock_);
+				throw;
+			}
+		}
+
+		~DiskCache() {
+			CloseHandle(lock_);
+		}
+
+		// Disable copy
+		DiskCache(const DiskCache&) = delete;
+		DiskCache& operator=(const DiskCache&) = delete;
+
+		// Returns the stored entry for key if its Vary headers match the request
+		std::shared_ptr<const CacheEntry> lookup(const std::string& key,
+			const std::unordered_map<std::string, std::string>& requestHeaders) {
+			uint64_t hash = fnv1a(key.data(), key.size());
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = index_.find(hash);
+			if (it == index_.end()) {
+				return nullptr;
+			}
+			const auto& segment = segments_.at(it->second.segment);
+			const char* record = segment->data() + it->second.offset;
+			RecordHeader header;
+			std::memcpy(&header, record, sizeof(header));
+			const char* keyData = record + sizeof(header);
+			if (std::string_view(keyData, header.key_size) != key) {
+				return nullptr; // Hash collision with a different key
+			}
+
+			auto entry = std::make_shared<CacheEntry>();
+			if (!decodeMeta(std::string_view(keyData + header.key_size, header.meta_size), *entry) ||
+				!entry->varyMatches(requestHeaders)) {
+				return nullptr;
+			}
+			entry->body = std::string_view(keyData + header.key_size + header.meta_size,
+				static_cast<size_t>(header.body_size));
+			entry->body_owner = segment;
+			entry->updateCharge();
+			++hits_;
+			return entry;
+		}
+
+		// Appends entry as the newest record for key. A failure to grow the cache
+		// (e.g. disk full) only skips the write; it never fails the request.
+		void store(const std::string& key, const CacheEntry& entry) {
+			std::string meta = encodeMeta(entry);
+			std::lock_guard<std::mutex> lock(mutex_);
+			try {
+				appendLocked(key, meta, entry.body, 0);
+			}
+			catch (const std::exception&) {
+				index_.erase(fnv1a(key.data(), key.size()));
+			}
+		}
+
+		// Appends a tombstone so the entry stays deleted across restarts
+		void erase(const std::string& key) {
+			uint64_t hash = fnv1a(key.data(), key.size());
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (index_.count(hash)) {
+				try {
+					appendLocked(key, std::string(), std::string_view(), kTombstone);
+				}
+				catch (const std::exception&) {
+					index_.erase(hash);
+				}
+			}
+		}
+
+		void fillStats(ResponseCacheStats& stats) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			stats.disk_hits = hits_;
+			stats.disk_entries = index_.size();
+			stats.disk_bytes = mapped_bytes_;
+		}
+
+	private:
+		struct Location {
+			uint32_t segment;
+			uint32_t offset;
+		};
+
+		struct RecordHeader {
+			uint32_t magic;
+			uint32_t flags;
+			uint64_t key_hash;
+			uint32_t key_size;
+			uint32_t meta_size;
+			uint64_t body_size;
+			uint64_t checksum;
+		};
+
+		static constexpr uint32_t kSegmentMagic = 0x47534348; // "HCSG"
+		static constexpr uint32_t kRecordMagic = 0x52434348;  // "HCCR"
+		static constexpr uint32_t kFormatVersion = 1;
+		static constexpr uint32_t kTombstone = 1;
+		static constexpr size_t kSegmentHeaderSize = 16;
+
+		static uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 0xcbf29ce484222325ull) {
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			for (size_t i = 0; i < size; ++i) {
+				hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+			}
+			return hash;
+		}
+
+		static uint64_t checksumOf(std::string_view key, std::string_view meta, std::string_view body) {
+			uint64_t hash = fnv1a(key.data(), key.size());
+			hash = fnv1a(meta.data(), meta.size(), hash);
+			return fnv1a(body.data(), body.size(), hash);
+		}
+
+		static void putU32(std::string& out, uint32_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+		static void putI64(std::string& out, int64_t value) { out.append(reinterpret_cast<const char*>(&value), sizeof(value)); }
+		static void putString(std::string& out, const std::string& value) {
+			putU32(out, static_cast<uint32_t>(value.size()));
+			out.append(value);
+		}
+
+		// Bounds-checked reader over an encoded metadata block
+		struct MetaReader {
+			std::string_view data;
+			bool ok = true;
+
+			template <typename T>
+			T read() {
+				T value{};
+				if (data.size() < sizeof(T)) {
+					ok = false;
+					return value;
+				}
+				std::memcpy(&value, data.data(), sizeof(T));
+				data.remove_prefix(sizeof(T));
+				return value;
+			}
+
+			std::string readString() {
+				uint32_t size = read<uint32_t>();
+				if (!ok || data.size() < size) {
+					ok = false;
+					return std::string();
+				}
+				std::string value(data.substr(0, size));
+				data.remove_prefix(size);
+				return value;
+			}
+		};
+
+		static std::string encodeMeta(const CacheEntry& entry) {
+			std::string out;
+			putU32(out, static_cast<uint32_t>(entry.status_code));
+			putI64(out, std::chrono::duration_cast<std::chrono::seconds>(entry.response_time.time_since_epoch()).count());
+			putI64(out, entry.corrected_initial_age.count());
+			putI64(out, entry.freshness_lifetime.count());
+			putU32(out, entry.must_revalidate_each_use ? 1 : 0);
+			putString(out, entry.etag);
+			putString(out, entry.last_modified);
+			putU32(out, static_cast<uint32_t>(entry.vary.size()));
+			for (const auto& [name, value] : entry.vary) {
+				putString(out, name);
+				putU32(out, value ? 1 : 0);
+				putString(out, value.value_or(std::string()));
+			}
+			putU32(out, static_cast<uint32_t>(entry.headers.size()));
+			for (const auto& [name, value] : entry.headers) {
+				putString(out, name);
+				putString(out, value);
+			}
+			return out;
+		}
+
+		static bool decodeMeta(std::string_view data, CacheEntry& entry) {
+			MetaReader reader{ data };
+			entry.status_code = static_cast<int>(reader.read<uint32_t>());
+			entry.response_time = std::chrono::system_clock::time_point(std::chrono::seconds{ reader.read<int64_t>() });
+			entry.corrected_initial_age = std::chrono::seconds{ reader.read<int64_t>() };
+			entry.freshness_lifetime = std::chrono::seconds{ reader.read<int64_t>() };
+			entry.must_revalidate_each_use = reader.read<uint32_t>() != 0;
+			entry.etag = reader.readString();
+			entry.last_modified = reader.readString();
+			uint32_t varyCount = reader.read<uint32_t>();
+			for (uint32_t i = 0; reader.ok && i < varyCount; ++i) {
+				std::string name = reader.readString();
+				bool present = reader.read<uint32_t>() != 0;
+				std::string value = reader.readString();
+				entry.vary.emplace_back(std::move(name), present ? std::optional<std::string>(std::move(value)) : std::nullopt);
+			}
+			uint32_t headerCount = reader.read<uint32_t>();
+			for (uint32_t i = 0; reader.ok && i < headerCount; ++i) {
+				std::string name = reader.readString();
+				entry.headers[name] = reader.readString();
+			}
+			return reader.ok;
+		}
+
+		std::filesystem::path segmentPath(uint32_t id) const {
+			char name[32];
+			std::snprintf(name, sizeof(name), "segment-%08u.hcs", id);
+			return directory_ / name;
+		}
+
+		void recover() {
+			std::vector<uint32_t> ids;
+			for (const auto& file : std::filesystem::directory_iterator(directory_)) {
+				unsigned id = 0;
+				if (std::sscanf(file.path().filename().string().c_str(), "segment-%08u.hcs", &id) == 1) {
+					ids.push_back(id);
+				}
+			}
+			std::sort(ids.begin(), ids.end());
+
+			for (uint32_t id : ids) {
+				// A segment the crash left empty or truncated, or one that cannot be mapped, is
+				// dropped on its own; it must not keep the rest of the cache from opening
+				std::error_code ec;
+				auto path = segmentPath(id);
+				auto fileSize = std::filesystem::file_size(path, ec);
+				std::shared_ptr<MappedSegment> segment;
+				if (!ec && fileSize >= kSegmentHeaderSize) {
+					try {
+						segment = std::make_shared<MappedSegment>(path, 0);
+					}
+					catch (const std::exception&) {
+					}
+				}
+				if (!segment) {
+					std::filesystem::remove(path, ec);
+					next_id_ = (std::max)(next_id_, id + 1); // Never reuse the name if it could not be removed
+					continue;
+				}
+				uint32_t header[4] = {};
+				std::memcpy(header, segment->data(), kSegmentHeaderSize);
+				if (header[0] != kSegmentMagic || header[1] != kFormatVersion || header[2] != id) {
+					segment->removeOnClose(); // Foreign or incompatible file
+					continue;
+				}
+				segments_[id] = segment;
+				mapped_bytes_ += segment->size();
+				next_id_ = id + 1;
+				active_ = segment;
+				active_id_ = id;
+				write_offset_ = scanSegment(id, *segment);
+			}
+			evictLocked();
+		}
+
+		// Replays the records of one segment into the index; returns the end of the valid log
+		size_t scanSegment(uint32_t id, const MappedSegment& segment) {
+			size_t offset = kSegmentHeaderSize;
+			while (offset + sizeof(RecordHeader) <= segment.size()) {
+				RecordHeader header;
+				std::memcpy(&header, segment.data() + offset, sizeof(header));
+				if (header.magic != kRecordMagic) break;
+				uint64_t payload = uint64_t(header.key_size) + header.meta_size + header.body_size;
+				if (payload > segment.size() - offset - sizeof(RecordHeader)) break;
+				const char* keyData = segment.data() + offset + sizeof(RecordHeader);
+				std::string_view key(keyData, header.key_size);
+				std::string_view meta(keyData + header.key_size, header.meta_size);
+				std::string_view body(keyData + header.key_size + header.meta_size, static_cast<size_t>(header.body_size));
+				if (checksumOf(key, meta, body) != header.checksum) break; // Torn write
+
+				if (header.flags & kTombstone) {
+					index_.erase(header.key_hash);
+				}
+				else {
+					index_[header.key_hash] = Location{ id, static_cast<uint32_t>(offset) };
+				}
+				offset += alignedSize(sizeof(RecordHeader) + payload);
+			}
+			return offset;
+		}
+
+		static size_t alignedSize(uint64_t size) { return static_cast<size_t>((size + 7) & ~uint64_t(7)); }
+
+		void appendLocked(const std::string& key, std::string_view meta, std::string_view body, uint32_t flags) {
+			size_t total = alignedSize(sizeof(RecordHeader) + key.size() + meta.size() + body.size());
+			if (total > options_.segment_bytes - kSegmentHeaderSize) {
+				return; // Larger than a segment; not cacheable on disk
+			}
+			if (!active_ || write_offset_ + total > active_->size()) {
+				rollLocked();
+			}
+
+			char* record = active_->data() + write_offset_;
+			char* keyData = record + sizeof(RecordHeader);
+			std::memcpy(keyData, key.data(), key.size());
+			if (!meta.empty()) std::memcpy(keyData + key.size(), meta.data(), meta.size());
+			if (!body.empty()) std::memcpy(keyData + key.size() + meta.size(), body.data(), body.size());
+
+			RecordHeader header{};
+			header.magic = kRecordMagic;
+			header.flags = flags;
+			header.key_hash = fnv1a(key.data(), key.size());
+			header.key_size = static_cast<uint32_t>(key.size());
+			header.meta_size = static_cast<uint32_t>(meta.size());
+			header.body_size = body.size();
+			header.checksum = checksumOf(key, meta, body);
+			std::memcpy(record, &header, sizeof(header));
+			active_->flush(write_offset_, total);
+
+			if (flags & kTombstone) {
+				index_.erase(header.key_hash);
+			}
+			else {
+				index_[header.key_hash] = Location{ active_id_, static_cast<uint32_t>(write_offset_) };
+			}
+			write_offset_ += total;
+		}
+
+		void rollLocked() {
+			uint32_t id = next_id_++;
+			auto segment = std::make_shared<MappedSegment>(segmentPath(id), options_.segment_bytes);
+			uint32_t header[4] = { kSegmentMagic, kFormatVersion, id, 0 };
+			std::memcpy(segment->data(), header, kSegmentHeaderSize);
+			segment->flush(0, kSegmentHeaderSize);
+			segments_[id] = segment;
+			mapped_bytes_ += segment->size();
+			active_ = segment;
+			active_id_ = id;
+			write_offset_ = kSegmentHeaderSize;
+			evictLocked();
+		}
+
+		void evictLocked() {
+			while (mapped_bytes_ > options_.max_bytes && segments_.size() > 1) {
+				auto oldest = segments_.begin();
+				for (auto it = index_.begin(); it != index_.end();) {
+					it = it->second.segment == oldest->first ? index_.erase(it) : std::next(it);
+				}
+				mapped_bytes_ -= oldest->second->size();
+				oldest->second->removeOnClose();
+				segments_.erase(oldest);
+			}
+		}
+
+		DiskCacheOptions options_;
+		std::filesystem::path directory_;
+		HANDLE lock_ = INVALID_HANDLE_VALUE;
+		std::mutex mutex_;
+		std::map<uint32_t, std::shared_ptr<MappedSegment>> segments_;
+		std::unordered_map<uint64_t, Location> index_;
+		std::shared_ptr<MappedSegment> active_;
+		uint32_t active_id_ = 0;
+		uint32_t next_id_ = 1;
+		size_t write_offset_ = 0;
+		size_t mapped_bytes_ = 0;
+		unsigned long long hits_ = 0;
+	};
+
+	// Private (per-client) HTTP cache following RFC 9111. Entries are immutable
+	// and shared, so the shard lock is held only to take a reference to a hit;
+	// the response built from it copies the headers and, unless zero_copy is
+	// set, the body. Each shard is a byte-bounded LRU with a TinyLFU admission filter.
+	class ResponseCache {
+	public:
+		using Entry = CacheEntry;
+
+		explicit ResponseCache(const ResponseCacheOptions& options)
+			: options_(options), shards_((std::max<size_t>)(1, options.shard_count)) {
+			for (auto& shard : shards_) {
+				shard.capacity = options_.max_bytes / shards_.size();
+			}
+			if (!options_.disk.directory.empty()) {
+				disk_ = std::make_unique<DiskCache>(options_.disk);
+			}
+		}
+
+		// Returns the stored entry for key if its Vary headers match the request,
+		// checking memory first and then the disk tier
+		std::shared_ptr<const Entry> lookup(const std::string& key,
+			const std::unordered_map<std::string, std::string>& requestHeaders) {
+			size_t hash = std::hash<std::string>{}(key);
+			Shard& shard = shardFor(hash);
+			{
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				shard.sketch.increment(hash);
+				auto it = shard.index.find(key);
+				if (it != shard.index.end() && it->second->second->varyMatches(requestHeaders)) {
+					shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+					++shard.stats.hits;
+					return it->second->second;
+				}
+				++shard.stats.misses;
+			}
+			auto entry = disk_ ? disk_->lookup(key, requestHeaders) : nullptr;
+			if (!entry || entry->charge + key.size() > shard.capacity) {
+				return entry;
+			}
+			// Promote the hit so repeated lookups stay in memory. The body is copied once so the
+			// memory tier never pins a disk segment that eviction wants to drop.
+			auto promoted = std::make_shared<Entry>(*entry);
+			auto body = std::make_shared<const std::string>(entry->body);
+			promoted->body = *body;
+			promoted->body_owner = std::move(body);
+			storeInMemory(key, promoted);
+			return promoted;
+		}
+
+		// Stores or replaces the entry for key in every tier
+		void store(const std::string& key, std::shared_ptr<const Entry> entry) {
+			if (disk_) {
+				disk_->store(key, *entry);
+			}
+			storeInMemory(key, std::move(entry));
+		}
+
+		void erase(const std::string& key) {
+			if (disk_) {
+				disk_->erase(key);
+			}
+			eraseFromMemory(key);
+		}
+
+		// True if hits expose the stored body through bodyView() instead of copying it
+		bool zeroCopy() const { return options_.zero_copy; }
+
+		ResponseCacheStats stats() {
+			ResponseCacheStats total;
+			for (auto& shard : shards_) {
+				std::lock_guard<std::mutex> lock(shard.mutex);
+				total.hits += shard.stats.hits;
+				total.misses += shard.stats.misses;
+				total.revalidations += shard.stats.revalidations;
+				total.stores += shard.stats.stores;
+				total.evictions += shard.stats.evictions;
+				total.admissions_rejected += shard.stats.admissions_rejected;
+				total.entries += shard.index.size();
+				total.bytes += shard.bytes;
+			}
+			if (disk_) {
+				disk_->fillStats(total);
+			}
+			return total;
+		}
+
+		void recordRevalidation(const std::string& key) {
+			Shard& shard = shardFor(std::hash<std::string>{}(key));
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			++shard.stats.revalidations;
+		}
+
+		// Builds an entry from a GET response, or returns nullptr if it may not be stored
+		std::shared_ptr<Entry> makeEntry(const HttpResponse& response,
+			const std::unordered_map<std::string, std::string>& requestHeaders,
+			std::chrono::system_clock::time_point requestTime,
+			std::chrono::system_clock::time_point responseTime) const {
+			using std::chrono::seconds;
+			auto directives = detail::parseCacheControl(response.getHeader("Cache-Control"));
+			if (directives.count("no-store") || response.status_code == 206 || response.status_code == 304 ||
+				response.status_code < 200) {
+				return nullptr;
+			}
+
+			auto entry = std::make_shared<Entry>();
+			entry->status_code = response.status_code;
+			entry->headers = response.headers;
+			auto body = std::make_shared<const std::string>(response.body);
+			entry->body = *body;
+			entry->body_owner = std::move(body);
+			entry->response_time = responseTime;
+			entry->etag = response.getHeader("ETag");
+			entry->last_modified = response.getHeader("Last-Modified");
+			entry->must_revalidate_each_use = directives.count("no-cache") > 0;
+
+			for (const auto& name : detail::splitList(response.getHeader("Vary"))) {
+				if (name == "*") return nullptr;
+				const std::string* value = detail::findHeader(requestHeaders, name);
+				entry->vary.emplace_back(detail::toLower(name),
+					value ? std::optional<std::string>(*value) : std::nullopt);
+			}
+
+			// Age calculation (RFC 9111 section 4.2.3)
+			auto date = detail::parseHttpDate(response.getHeader("Date")).value_or(responseTime);
+			auto apparentAge = (std::max)(seconds{ 0 }, std::chrono::duration_cast<seconds>(responseTime - date));
+			std::string ageHeader = response.getHeader("Age");
+			seconds ageValue{ std::all_of(ageHeader.begin(), ageHeader.end(), [](unsigned char c) { return std::isdigit(c); })
+				? std::strtoll(ageHeader.c_str(), nullptr, 10) : 0 };
+			auto responseDelay = std::chrono::duration_cast<seconds>(responseTime - requestTime);
+			entry->corrected_initial_age = (std::max)(apparentAge, ageValue + responseDelay);
+
+			// Freshness lifetime (RFC 9111 section 4.2.1); s-maxage is for shared caches only
+			bool explicitFreshness = true;
+			if (auto maxAge = detail::deltaSeconds(directives, "max-age")) {
+				entry->freshness_lifetime = seconds{ *maxAge };
+			}
+			else if (const std::string* expires = detail::findHeader(response.headers, "Expires")) {
+				auto expiresAt = detail::parseHttpDate(*expires);
+				entry->freshness_lifetime = expiresAt
+					? (std::max)(seconds{ 0 }, std::chrono::duration_cast<seconds>(*expiresAt - date)) : seconds{ 0 };
+			}
+			else {
+				explicitFreshness = false;
+				auto lastModified = detail::parseHttpDate(entry->last_modified);
+				if (lastModified && isHeuristicallyCacheable(response.status_code) && *lastModified < date) {
+					// Heuristic freshness: 10% of the time since last modification
+					entry->freshness_lifetime = (std::min)(options_.max_heuristic_freshness,
+						std::chrono::duration_cast<seconds>((date - *lastModified) / 10));
+				}
+			}
+
+			if (!explicitFreshness && !isHeuristicallyCacheable(response.status_code)) {
+				return nullptr;
+			}
+			if (entry->freshness_lifetime.count() == 0 && !entry->hasValidator()) {
+				return nullptr; // Could never be served without a full refetch
+			}
+
+			entry->updateCharge();
+			return entry;
+		}
+
+		// Applies a 304 response to a stored entry (RFC 9111 section 4.3.4)
+		std::shared_ptr<Entry> freshen(const Entry& stored, const HttpResponse& notModified,
+			const std::unordered_map<std::string, std::string>& requestHeaders,
+			std::chrono::system_clock::time_point requestTime,
+			std::chrono::system_clock::time_point responseTime) const {
+			HttpResponse merged;
+			merged.status_code = stored.status_code;
+			merged.headers = stored.headers;
+			for (const auto& [key, value] : notModified.headers) {
+				if (detail::equalsIgnoreCase(key, "Content-Length")) continue;
+				for (auto it = merged.headers.begin(); it != merged.headers.end();) {
+					it = detail::equalsIgnoreCase(it->first, key) ? merged.headers.erase(it) : std::next(it);
+				}
+				merged.headers[key] = value;
+			}
+			auto entry = makeEntry(merged, requestHeaders, requestTime, responseTime);
+			if (entry) {
+				// Share rather than copy the unchanged body
+				entry->body = stored.body;
+				entry->body_owner = stored.body_owner;
+				entry->updateCharge();
+			}
+			return entry;
+		}
+
+	private:
+		// Count-min sketch with saturating 4-bit counters and periodic halving, as in TinyLFU
+		class FrequencySketch {
+		public:
+			FrequencySketch() : table_(kWidth * kDepth, 0) {}
+
+			void increment(size_t hash) {
+				for (size_t row = 0; row < kDepth; ++row) {
+					uint8_t& counter = table_[row * kWidth + indexOf(hash, row)];
+					if (counter < 15) ++counter;
+				}
+				if (++additions_ >= kWidth * 10) {
+					for (auto& counter : table_) counter >>= 1;
+					additions_ = 0;
+				}
+			}
+
+			uint8_t estimate(size_t hash) const {
+				uint8_t result = 15;
+				for (size_t row = 0; row < kDepth; ++row) {
+					result = (std::min)(result, table_[row * kWidth + indexOf(hash, row)]);
+				}
+				return result;
+			}
+
+		private:
+			static constexpr size_t kWidth = 4096;
+			static constexpr size_t kDepth = 4;
+
+			static size_t indexOf(size_t hash, size_t row) {
+				uint64_t h = (static_cast<uint64_t>(hash) + row) * 0x9E3779B97F4A7C15ull;
+				return static_cast<size_t>(h >> (32 + row * 4)) & (kWidth - 1);
+			}
+
+			std::vector<uint8_t> table_;
+			size_t additions_ = 0;
+		};
+
+		using LruList = std::list<std::pair<std::string, std::shared_ptr<const Entry>>>;
+
+		struct Shard {
+			std::mutex mutex;
+			LruList lru;
+			std::unordered_map<std::string, LruList::iterator> index;
+			FrequencySketch sketch;
+			size_t bytes = 0;
+			size_t capacity = 0;
+			ResponseCacheStats stats;
+		};
+
+		static bool isHeuristicallyCacheable(int status) {
+			switch (status) {
+			case 200: case 203: case 204: case 300: case 301: case 308:
+			case 404: case 405: case 410: case 414: case 501:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		// Stores or replaces the entry in this shard, evicting least recently used entries
+		void storeInMemory(const std::string& key, std::shared_ptr<const Entry> entry) {
+			size_t hash = std::hash<std::string>{}(key);
+			Shard& shard = shardFor(hash);
+			size_t charge = entry->charge + key.size();
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			if (charge > shard.capacity) {
+				return;
+			}
+
+			auto existing = shard.index.find(key);
+			if (existing != shard.index.end()) {
+				shard.bytes -= existing->second->second->charge + key.size();
+				shard.lru.erase(existing->second);
+				shard.index.erase(existing);
+			}
+			else if (options_.tiny_lfu_admission && shard.bytes + charge > shard.capacity && !shard.lru.empty()) {
+				size_t victimHash = std::hash<std::string>{}(shard.lru.back().first);
+				if (shard.sketch.estimate(hash) < shard.sketch.estimate(victimHash)) {
+					++shard.stats.admissions_rejected;
+					return;
+				}
+			}
+
+			while (shard.bytes + charge > shard.capacity && !shard.lru.empty()) {
+				auto& victim = shard.lru.back();
+				shard.bytes -= victim.second->charge + victim.first.size();
+				shard.index.erase(victim.first);
+				shard.lru.pop_back();
+				++shard.stats.evictions;
+			}
+
+			shard.lru.emplace_front(key, std::move(entry));
+			shard.index[key] = shard.lru.begin();
+			shard.bytes += charge;
+			++shard.stats.stores;
+		}
+
+		void eraseFromMemory(const std::string& key) {
+			Shard& shard = shardFor(std::hash<std::string>{}(key));
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			auto it = shard.index.find(key);
+			if (it != shard.index.end()) {
+				shard.bytes -= it->second->second->charge + key.size();
+				shard.lru.erase(it->second);
+				shard.index.erase(it);
+			}
+		}
+
+		Shard& shardFor(size_t hash) { return shards_[(hash >> 7) % shards_.size()]; }
+
+		ResponseCacheOptions options_;
+		std::vector<Shard> shards_;
+		std::unique_ptr<DiskCache> disk_;
+	};
+
+	// Coalesces concurrent identical requests into one exchange. The first
+	// caller (the leader) performs the request; callers arriving while it is in
+	// flight wait for its result, each no longer than its own deadline and stop
+	// token allow. Every caller gets its own copy of the body. With zero-copy
+	// enabled the body is moved into one shared buffer instead, and every caller,
+	// the leader included, receives a view of it through bodyView().
+	class SingleFlight {
+	public:
+		explicit SingleFlight(bool zeroCopy = false) : zero_copy_(zeroCopy) {}
+
+		// Any request header may be named by the response's Vary, so all of them
+		// are part of the key; requests differing in any header never share a result
+		static std::string keyFor(const std::string& method, const std::string& scheme,
+			const std::string& host, unsigned short port, const std::string& path,
+			const std::unordered_map<std::string, std::string>& headers) {
+			std::vector<std::pair<std::string, std::string>> sorted;
+			sorted.reserve(headers.size());
+			for (const auto& [key, value] : headers) {
+				sorted.emplace_back(detail::toLower(key), value);
+			}
+			std::sort(sorted.begin(), sorted.end());
+			std::string key = method + " " + scheme + "://" + host + ":" + std::to_string(port) + path;
+			for (const auto& [name, value] : sorted) {
+				key += "\n" + name + ":" + value;
+			}
+			return key;
+		}
+
+		template <typename Fn>
+		HttpResponse run(const std::string& key, Fn&& fn) {
+			for (;;) {
+				std::shared_ptr<Call> call;
+				bool leader = false;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					auto& slot = calls_[key];
+					if (!slot) {
+						slot = std::make_shared<Call>();
+						leader = true;
+					}
+					else {
+						++slot->followers;
+					}
+					call = slot;
+				}
+				if (leader) {
+					return lead(key, *call, fn);
+				}
+
+				std::unique_lock<std::mutex> lock(call->mutex);
+				const std::stop_token& stop = detail::StopScope::token();
+				auto deadline = TimeoutScope::deadline();
+				auto ready = [&]() { return call->done; };
+				bool done = deadline ? call->finished.wait_until(lock, stop, *deadline, ready)
+					: call->finished.wait(lock, stop, ready);
+				if (!done) {
+					// This caller's own limit ended the wait; the exchange goes on for the others
+					HttpResponse response;
+					bool stopped = stop.stop_requested();
+					response.error = stopped ? "Request cancelled." : "Request deadline exceeded.";
+					response.error_kind = stopped ? ErrorKind::Cancelled : ErrorKind::Timeout;
+					return response;
+				}
+				lock.unlock(); // The result no longer changes, so followers copy it in parallel
+				if (call->error) {
+					std::rethrow_exception(call->error);
+				}
+				// The leader's own deadline or stop token ended its exchange, which says nothing
+				// about this caller's request, so it goes round again
+				if (call->result.error_kind == ErrorKind::Timeout || call->result.error_kind == ErrorKind::Cancelled) {
+					continue;
+				}
+				return call->result;
+			}
+		}
+
+	private:
+		struct Call {
+			std::mutex mutex;
+			std::condition_variable_any finished;
+			bool done = false;
+			HttpResponse result;
+			std::exception_ptr error;
+			int followers = 0; // Guarded by SingleFlight::mutex_
+		};
+
+		template <typename Fn>
+		HttpResponse lead(const std::string& key, Call& call, Fn& fn) {
+			HttpResponse response;
+			try {
+				response = fn();
+			}
+			catch (...) {
+				finish(key);
+				publish(call, [&]() { call.error = std::current_exception(); });
+				throw;
+			}
+			if (zero_copy_ && !response.body.empty()) {
+				auto buffer = std::make_shared<const std::string>(std::move(response.body));
+				response.body.clear();
+				response.setBodyView(*buffer, buffer);
+			}
+			// Nobody can join once the call is removed, so without followers nothing is copied
+			if (finish(key) > 0) {
+				publish(call, [&]() { call.result = response; });
+			}
+			else {
+				publish(call, []() {});
+			}
+			return response;
+		}
+
+		template <typename Fill>
+		static void publish(Call& call, Fill&& fill) {
+			{
+				std::lock_guard<std::mutex> lock(call.mutex);
+				fill();
+				call.done = true;
+			}
+			call.finished.notify_all();
+		}
+
+		// Removes the in-flight call; returns how many followers joined it
+		int finish(const std::string& key) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = calls_.find(key);
+			int followers = it->second->followers;
+			calls_.erase(it);
+			return followers;
+		}
+
+		bool zero_copy_;
+		std::mutex mutex_;
+		std::unordered_map<std::string, std::shared_ptr<Call>> calls_;
+	};
+
+	// Controls how 3xx responses are followed
+	struct RedirectPolicy {
+		bool follow = true;                // Return 3xx responses as-is when false
+		int max_redirects = 10;
+		bool allow_https_to_http = false;  // Refuse to downgrade to plain HTTP, as WinHTTP does by default
+		bool cache_permanent = true;       // Remember 301/308 targets so later requests skip the hop
+		size_t permanent_cache_entries = 1024;
+	};
+
+	// Remembers 301 and 308 redirects (RFC 9110 section 15.4.2 and 15.4.9), least recently used first out
+	class RedirectCache {
+	public:
+		explicit RedirectCache(size_t capacity) : capacity_(capacity) {}
+
+		struct Target {
+			std::string url;
+			int status_code;
+		};
+
+		void store(const std::string& from, const std::string& to, int statusCode,
+			std::optional<std::chrono::steady_clock::time_point> expires) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = entries_.find(from);
+			if (it != entries_.end()) {
+				order_.erase(it->second.position);
+				entries_.erase(it);
+			}
+			order_.push_front(from);
+			entries_[from] = Entry{ Target{ to, statusCode }, expires, order_.begin() };
+			while (entries_.size() > capacity_) {
+				entries_.erase(order_.back());
+				order_.pop_back();
+			}
+		}
+
+		std::optional<Target> find(const std::string& from) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = entries_.find(from);
+			if (it == entries_.end()) return std::nullopt;
+			if (it->second.expires && *it->second.expires <= std::chrono::steady_clock::now()) {
+				order_.erase(it->second.position);
+				entries_.erase(it);
+				return std::nullopt;
+			}
+			order_.splice(order_.begin(), order_, it->second.position);
+			return it->second.target;
+		}
+
+		void erase(const std::string& from) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto it = entries_.find(from);
+			if (it != entries_.end()) {
+				order_.erase(it->second.position);
+				entries_.erase(it);
+			}
+		}
+
+	private:
+		struct Entry {
+			Target target;
+			std::optional<std::chrono::steady_clock::time_point> expires;
+			std::list<std::string>::iterator position;
+		};
+
+		std::mutex mutex_;
+		size_t capacity_;
+		std::list<std::string> order_;
+		std::unordered_map<std::string, Entry> entries_;
+	};
+
+	// A cookie as stored by CookieJar (RFC 6265 section 5.3)
+	struct Cookie {
+		std::string name;
+		std::string value;
+		std::string domain;      // Lowercase, without a leading dot
+		std::string path;
+		std::optional<std::chrono::system_clock::time_point> expires; // Unset for session cookies
+		bool host_only = true;   // Set without a Domain attribute: sent to that exact host only
+		bool secure = false;
+		bool http_only = false;
+		std::chrono::system_clock::time_point creation_time;
+	};
+
+	// Thread-safe cookie store. Cookies live in a trie keyed by reversed domain
+	// labels ("com" -> "example" -> "www"), so finding the cookies for a host
+	// visits one node per label no matter how many cookies are stored.
+	// Expired cookies are dropped when a lookup passes over them.
+	class CookieJar {
+	public:
+		// Stores the cookies from a response's Set-Cookie headers
+		void store(const std::string& host, const std::string& path, const std::vector<std::string>& setCookies) {
+			auto now = std::chrono::system_clock::now();
+			std::lock_guard<std::mutex> lock(mutex_);
+			for (const auto& header : setCookies) {
+				Cookie cookie;
+				if (parse(header, detail::toLower(host), path, now, cookie)) {
+					insert(std::move(cookie), now);
+				}
+			}
+		}
+
+		// Builds the Cookie header value for a request, or "" if no cookie applies
+		std::string cookieHeader(const std::string& host, const std::string& path, bool secure) {
+			auto now = std::chrono::system_clock::now();
+			auto labels = reversedLabels(detail::toLower(host));
+			std::vector<const Cookie*> matches;
+			std::lock_guard<std::mutex> lock(mutex_);
+			Node* node = &root_;
+			for (size_t depth = 0; depth < labels.size() && node; ++depth) {
+				auto child = node->children.find(labels[depth]);
+				node = child == node->children.end() ? nullptr : child->second.get();
+				if (!node) break;
+				bool exactHost = depth + 1 == labels.size();
+				auto& cookies = node->cookies;
+				auto live = std::remove_if(cookies.begin(), cookies.end(), [&](const Cookie& c) {
+					return c.expires && *c.expires <= now;
+				});
+				count_ -= static_cast<size_t>(cookies.end() - live);
+				cookies.erase(live, cookies.end());
+				for (const auto& cookie : cookies) {
+					if ((exactHost || !cookie.host_only) && (secure || !cookie.secure) && pathMatches(path, cookie.path)) {
+						matches.push_back(&cookie);
+					}
+				}
+			}
+
+			// Longer paths first, then older cookies first (RFC 6265 section 5.4)
+			std::stable_sort(matches.begin(), matches.end(), [](const Cookie* a, const Cookie* b) {
+				if (a->path.size() != b->path.size()) return a->path.size() > b->path.size();
+				return a->creation_time < b->creation_time;
+			});
+			std::string header;
+			for (const Cookie* cookie : matches) {
+				if (!header.empty()) header += "; ";
+				header += cookie->name + "=" + cookie->value;
+			}
+			return header;
+		}
+
+		// Returns all unexpired cookies
+		std::vector<Cookie> cookies() const {
+			auto now = std::chrono::system_clock::now();
+			std::vector<Cookie> all;
+			std::lock_guard<std::mutex> lock(mutex_);
+			collect(root_, now, all);
+			return all;
+		}
+
+		size_t size() const {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return count_;
+		}
+
+		void clear() {
+			std::lock_guard<std::mutex> lock(mutex_);
+			root_.children.clear();
+			root_.cookies.clear();
+			count_ = 0;
+		}
+
+	private:
+		// Upper bound on any cookie's lifetime (RFC 6265bis section 5.6)
+		static constexpr std::chrono::seconds kMaxLifetime{ 400LL * 24 * 60 * 60 };
+
+		struct Node {
+			std::unordered_map<std::string, std::unique_ptr<Node>> children;
+			std::vector<Cookie> cookies;
+		};
+
+		static bool isIpAddress(const std::string& host) {
+			return host.find(':') != std::string::npos ||
+				(!host.empty() && std::all_of(host.begin(), host.end(), [](unsigned char c) { return std::isdigit(c) || c == '.'; }));
+		}
+
+		// "www.example.com" -> {"com", "example", "www"}; IP addresses stay one label
+		static std::vector<std::string> reversedLabels(const std::string& host) {
+			if (isIpAddress(host)) return { host };
+			std::vector<std::string> labels;
+			size_t end = host.size();
+			while (end > 0) {
+				size_t dot = host.rfind('.', end - 1);
+				size_t start = dot == std::string::npos ? 0 : dot + 1;
+				if (end > start) labels.push_back(host.substr(start, end - start));
+				if (dot == std::string::npos) break;
+				end = dot;
+			}
+			return labels;
+		}
+
+		// RFC 6265 section 5.1.4
+		static bool pathMatches(const std::string& requestPath, const std::string& cookiePath) {
+			if (requestPath.compare(0, cookiePath.size(), cookiePath) != 0) return false;
+			return requestPath.size() == cookiePath.size() || cookiePath.back() == '/' ||
+				requestPath[cookiePath.size()] == '/';
+		}
+
+		static std::string defaultPath(const std::string& requestPath) {
+			std::string path = requestPath.substr(0, requestPath.find('?'));
+			if (path.empty() || path[0] != '/') return "/";
+			auto slash = path.rfind('/');
+			return slash == 0 ? "/" : path.substr(0, slash);
+		}
+
+		// Parses one Set-Cookie header (RFC 6265 section 5.2); false if it must be ignored
+		static bool parse(const std::string& header, const std::string& host, const std::string& requestPath,
+			std::chrono::system_clock::time_point now, Cookie& cookie) {
+			std::string pair = header.substr(0, header.find(';'));
+			auto equals = pair.find('=');
+			if (equals == std::string::npos) return false;
+			cookie.name = detail::trim(pair.substr(0, equals));
+			cookie.value = detail::trim(pair.substr(equals + 1));
+			if (cookie.name.empty()) return false;
+
+			std::optional<std::chrono::system_clock::time_point> maxAgeExpiry, dateExpiry;
+			std::string domain;
+			size_t pos = header.find(';');
+			while (pos != std::string::npos) {
+				size_t next = header.find(';', pos + 1);
+				std::string attribute = header.substr(pos + 1, next == std::string::npos ? std::string::npos : next - pos - 1);
+				pos = next;
+				auto eq = attribute.find('=');
+				std::string key = detail::toLower(detail::trim(attribute.substr(0, eq)));
+				std::string value = eq == std::string::npos ? "" : detail::trim(attribute.substr(eq + 1));
+				if (key == "max-age") {
+					char* end = nullptr;
+					long long seconds = std::strtoll(value.c_str(), &end, 10);
+					if (!value.empty() && end && *end == '\0') {
+						// Clamped before adding, so a huge Max-Age cannot overflow the time point
+						maxAgeExpiry = seconds <= 0 ? (std::chrono::system_clock::time_point::min)()
+							: now + (std::min)(std::chrono::seconds{ seconds }, kMaxLifetime);
+					}
+				}
+				else if (key == "expires") {
+					dateExpiry = detail::parseHttpDate(value);
+				}
+				else if (key == "domain") {
+					domain = detail::toLower(value);
+					if (!domain.empty() && domain[0] == '.') domain.erase(0, 1);
+				}
+				else if (key == "path") {
+					cookie.path = value;
+				}
+				else if (key == "secure") {
+					cookie.secure = true;
+				}
+				else if (key == "httponly") {
+					cookie.http_only = true;
+				}
+			}
+			// Max-Age takes precedence over Expires; neither may reach past the lifetime cap
+			cookie.expires = maxAgeExpiry ? maxAgeExpiry : dateExpiry;
+			if (cookie.expires && *cookie.expires > now + kMaxLifetime) {
+				cookie.expires = now + kMaxLifetime;
+			}
+
+			if (domain.empty() || domain == host) {
+				cookie.host_only = domain.empty();
+				cookie.domain = host;
+			}
+			else {
+				// The host must domain-match, and without a public suffix list a bare
+				// top-level label such as "com" is refused outright
+				bool matches = host.size() > domain.size() && host.compare(host.size() - domain.size(), domain.size(), domain) == 0 &&
+					host[host.size() - domain.size() - 1] == '.' && !isIpAddress(host);
+				if (!matches || domain.find('.') == std::string::npos) return false;
+				cookie.host_only = false;
+				cookie.domain = domain;
+			}
+			if (cookie.path.empty() || cookie.path[0] != '/') {
+				cookie.path = defaultPath(requestPath);
+			}
+			cookie.creation_time = now;
+			return true;
+		}
+
+		// Adds or replaces a cookie; an already expired cookie deletes its namesake
+		void insert(Cookie cookie, std::chrono::system_clock::time_point now) {
+			Node* node = &root_;
+			for (const auto& label : reversedLabels(cookie.domain)) {
+				auto& child = node->children[label];
+				if (!child) child = std::make_unique<Node>();
+				node = child.get();
+			}
+			auto& cookies = node->cookies;
+			auto existing = std::find_if(cookies.begin(), cookies.end(), [&](const Cookie& c) {
+				return c.name == cookie.name && c.path == cookie.path && c.host_only == cookie.host_only;
+			});
+			bool expired = cookie.expires && *cookie.expires <= now;
+			if (existing != cookies.end()) {
+				if (expired) {
+					cookies.erase(existing);
+					--count_;
+				}
+				else {
+					cookie.creation_time = existing->creation_time;
+					*existing = std::move(cookie);
+				}
+			}
+			else if (!expired) {
+				cookies.push_back(std::move(cookie));
+				++count_;
+			}
+		}
+
+		static void collect(const Node& node, std::chrono::system_clock::time_point now, std::vector<Cookie>& out) {
+			for (const auto& cookie : node.cookies) {
+				if (!cookie.expires || *cookie.expires > now) out.push_back(cookie);
+			}
+			for (const auto& [label, child] : node.children) {
+				collect(*child, now, out);
+			}
+		}
+
+		mutable std::mutex mutex_;
+		Node root_;
+		size_t count_ = 0;
+	};
+
+	// A request body produced incrementally instead of held in memory. read fills up to
+	// `capacity` bytes and returns the count, 0 at the end; it throws on failure. Without
+	// a length the body is sent with chunked transfer encoding.
+	struct UploadBody {
+		std::optional<uint64_t> length;
+		std::function<size_t(char* buffer, size_t capacity)> read;
+	};
+
+	// Builds a multipart/form-data body (RFC 7578) whose parts are streamed, not concatenated
+	class MultipartForm {
+	public:
+		using Reader = std::function<size_t(char* buffer, size_t capacity)>;
+
+		MultipartForm() {
+			static const char digits[] = "0123456789abcdef";
+			std::uniform_int_distribution<int> dist(0, 15);
+			boundary_ = "----HttpClientBoundary";
+			for (int i = 0; i < 24; ++i) {
+				boundary_ += digits[dist(detail::randomEngine())];
+			}
+		}
+
+		// Adds a plain form field
+		MultipartForm& addField(const std::string& name, const std::string& value,
+			const std::string& contentType = "") {
+			Part part;
+			part.head = partHead(name, nullptr, contentType);
+			part.text = value;
+			part.size = value.size();
+			parts_.push_back(std::move(part));
+			return *this;
+		}
+
+		// Adds a file, read from disk while the request is sent
+		MultipartForm& addFile(const std::string& name, const std::string& path,
+			const std::string& filename = "", const std::string& contentType = "application/octet-stream") {
+			std::string sentName = filename;
+			if (sentName.empty()) {
+				auto slash = path.find_last_of("/\\");
+				sentName = slash == std::string::npos ? path : path.substr(slash + 1);
+			}
+			Part part;
+			part.head = partHead(name, &sentName, contentType);
+			part.path = path;
+			parts_.push_back(std::move(part));
+			return *this;
+		}
+
+		// Adds a part produced by a callback. Without a size the whole form is sent chunked.
+		MultipartForm& addStream(const std::string& name, const std::string& filename, Reader reader,
+			std::optional<uint64_t> size = std::nullopt, const std::string& contentType = "application/octet-stream") {
+			Part part;
+			part.head = partHead(name, &filename, contentType);
+			part.reader = std::move(reader);
+			part.size = size;
+			parts_.push_back(std::move(part));
+			return *this;
+		}
+
+		const std::string& boundary() const { return boundary_; }
+		std::string contentType() const { return "multipart/form-data; boundary=" + boundary_; }
+
+		// Returns a streaming body over the current parts. File sizes are taken now and
+		// enforced while sending, so a file that changes size fails the upload.
+		UploadBody body() const {
+			auto state = std::make_shared<ReadState>();
+			state->parts = parts_;
+			uint64_t total = 0;
+			bool known = true;
+			for (auto& part : state->parts) {
+				if (!part.path.empty()) {
+					std::error_code ec;
+					part.size = std::filesystem::file_size(detail::pathFromUtf8(part.path), ec);
+					if (ec) {
+						throw std::runtime_error("Cannot read multipart file: " + part.path);
+					}
+				}
+				if (!part.size) {
+					known = false;
+				}
+				total += part.head.size() + part.size.value_or(0) + 2;
+			}
+			state->trailer = "--" + boundary_ + "--\r\n";
+			total += state->trailer.size();
+
+			UploadBody upload;
+			if (known) {
+				upload.length = total;
+			}
+			upload.read = [state](char* buffer, size_t capacity) { return state->read(buffer, capacity); };
+			return upload;
+		}
+
+	private:
+		struct Part {
+			std::string head;
+			std::string text;
+			std::string path;
+			Reader reader;
+			std::optional<uint64_t> size;
+		};
+
+		// Walks the parts in wire order: head, content, CRLF, and finally the closing boundary
+		struct ReadState {
+			std::vector<Part> parts;
+			std::string trailer;
+			size_t part = 0;
+			int stage = 0; // 0 head, 1 content, 2 CRLF
+			uint64_t offset = 0;
+			std::ifstream file;
+
+			size_t read(char* buffer, size_t capacity) {
+				size_t filled = 0;
+				while (filled < capacity) {
+					if (part == parts.size()) {
+						filled += copyFrom(trailer, buffer + filled, capacity - filled);
+						break;
+					}
+					Part& current = parts[part];
+					size_t n = 0;
+					if (stage == 0) {
+						n = copyFrom(current.head, buffer + filled, capacity - filled);
+					}
+					else if (stage == 1) {
+						n = readContent(current, buffer + filled, capacity - filled);
+					}
+					else {
+						n = copyFrom("\r\n", buffer + filled, capacity - filled);
+					}
+					filled += n;
+					if (n == 0) {
+						// Current stage exhausted
+						offset = 0;
+						if (++stage == 3) {
+							stage = 0;
+							++part;
+						}
+					}
+				}
+				return filled;
+			}
+
+			size_t copyFrom(std::string_view source, char* buffer, size_t capacity) {
+				size_t n = static_cast<size_t>((std::min<uint64_t>)(capacity, source.size() - offset));
+				std::memcpy(buffer, source.data() + offset, n);
+				offset += n;
+				return n;
+			}
+
+			size_t readContent(Part& current, char* buffer, size_t capacity) {
+				if (current.size) {
+					capacity = static_cast<size_t>((std::min<uint64_t>)(capacity, *current.size - offset));
+					if (capacity == 0) {
+						file.close();
+						return 0;
+					}
+				}
+				size_t n = 0;
+				if (!current.path.empty()) {
+					if (!file.is_open()) {
+						file.open(detail::pathFromUtf8(current.path), std::ios::binary);
+						if (!file) throw std::runtime_error("Cannot open multipart file: " + current.path);
+					}
+					file.read(buffer, static_cast<std::streamsize>(capacity));
+					n = static_cast<size_t>(file.gcount());
+				}
+				else if (current.reader) {
+					n = current.reader(buffer, capacity);
+				}
+				else {
+					n = copyFrom(current.text, buffer, capacity);
+					return n;
+				}
+				if (n == 0 && current.size) {
+					// The declared Content-Length can no longer be honoured
+					throw std::runtime_error("Multipart part ended before its declared size.");
+				}
+				offset += n;
+				return n;
+			}
+		};
+
+		static std::string escapeQuoted(const std::string& value) {
+			// Quotes and line breaks are percent-encoded as browsers do
+			std::string escaped;
+			for (char c : value) {
+				if (c == '"') escaped += "%22";
+				else if (c == '\r') escaped += "%0D";
+				else if (c == '\n') escaped += "%0A";
+				else escaped += c;
+			}
+			return escaped;
+		}
+
+		std::string partHead(const std::string& name, const std::string* filename, const std::string& contentType) const {
+			std::string head = "--" + boundary_ + "\r\nContent-Disposition: form-data; name=\"" + escapeQuoted(name) + "\"";
+			if (filename) {
+				head += "; filename=\"" + escapeQuoted(*filename) + "\"";
+			}
+			head += "\r\n";
+			if (!contentType.empty()) {
+				head += "Content-Type: " + contentType + "\r\n";
+			}
+			head += "\r\n";
+			return head;
+		}
+
+		std::string boundary_;
+		std::vector<Part> parts_;
+	};
+
+	// Destination of a download. writeAt is called concurrently for disjoint ranges.
+	class DownloadSink {
+	public:
+		virtual ~DownloadSink() = default;
+
+		// Called before any data with the total size, or 0 if the size is unknown
+		virtual bool prepare(uint64_t totalSize) = 0;
+
+		virtual bool writeAt(uint64_t offset, const char* data, size_t size) = 0;
+	};
+
+	// Collects a download in memory
+	class BufferSink : public DownloadSink {
+	public:
+		bool prepare(uint64_t totalSize) override {
+			buffer_.resize(static_cast<size_t>(totalSize));
+			return true;
+		}
+
+		bool writeAt(uint64_t offset, const char* data, size_t size) override {
+			if (offset + size > buffer_.size()) {
+				// Only reached when the size was unknown, in which case writes are sequential
+				buffer_.resize(static_cast<size_t>(offset + size));
+			}
+			std::memcpy(&buffer_[static_cast<size_t>(offset)], data, size);
+			return true;
+		}
+
+		const std::string& data() const { return buffer_; }
+		std::string release() { return std::move(buffer_); }
+
+	private:
+		std::string buffer_;
+	};
+
+	// Writes a download into a file, preallocated to its final size
+	class FileSink : public DownloadSink {
+	public:
+		explicit FileSink(const std::string& path) : path_(path) {}
+
+		~FileSink() override {
+			if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+		}
+
+		// Disable copy
+		FileSink(const FileSink&) = delete;
+		FileSink& operator=(const FileSink&) = delete;
+
+		bool prepare(uint64_t totalSize) override {
+			if (file_ == INVALID_HANDLE_VALUE) {
+				file_ = CreateFileW(detail::pathFromUtf8(path_).wstring().c_str(), GENERIC_READ | GENERIC_WRITE,
+					FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+				if (file_ == INVALID_HANDLE_VALUE) return false;
+			}
+			LARGE_INTEGER size;
+			size.QuadPart = static_cast<LONGLONG>(totalSize);
+			return SetFilePointerEx(file_, size, NULL, FILE_BEGIN) && SetEndOfFile(file_);
+		}
+
+		bool writeAt(uint64_t offset, const char* data, size_t size) override {
+			while (size > 0) {
+				// Positional writes through OVERLAPPED are safe from several threads
+				OVERLAPPED overlapped = {};
+				overlapped.Offset = static_cast<DWORD>(offset & 0xFFFFFFFF);
+				overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+				DWORD written = 0;
+				DWORD chunk = static_cast<DWORD>((std::min<size_t>)(size, 1u << 30));
+				if (!WriteFile(file_, data, chunk, &written, &overlapped) || written == 0) {
+					return false;
+				}
+				offset += written;
+				data += written;
+				size -= written;
+			}
+			return true;
+		}
+
+		// Makes written data durable before progress referring to it is recorded
+		bool flush() { return file_ != INVALID_HANDLE_VALUE && FlushFileBuffers(file_); }
+
+		void close() {
+			if (file_ != INVALID_HANDLE_VALUE) {
+				CloseHandle(file_);
+				file_ = INVALID_HANDLE_VALUE;
+			}
+		}
+
+		const std::string& path() const { return path_; }
+
+	private:
+		std::string path_;
+		HANDLE file_ = INVALID_HANDLE_VALUE;
+	};
+
+	// Controls how downloadParallel splits and retries a transfer
+	struct DownloadOptions {
+		uint64_t min_segment_bytes = 1024 * 1024; // Smaller objects use fewer segments
+		int max_segment_attempts = 5;             // Each attempt resumes where the last one stopped
+		uint64_t journal_checkpoint_bytes = 8 * 1024 * 1024; // Progress is journaled after this many new bytes
+	};
+
+	// Controls HttpClient::streamJsonLines
+	struct JsonLinesOptions {
+		size_t max_line_size = 16 * 1024 * 1024; // A longer record fails the stream
+		bool skip_invalid = false;                // Skip lines that are not valid JSON instead of failing
+	};
+
+	// Incremental parser for newline-delimited JSON. Only a partial line is ever
+	// buffered; a line that arrives whole inside one chunk is parsed in place.
+	class JsonLinesParser {
+	public:
+		explicit JsonLinesParser(JsonLinesOptions options = {}) : options_(options) {}
+
+		// Feeds a chunk; onRecord returning false stops parsing. Returns false when
+		// parsing stopped (see stopped) or a line was invalid or too long (see error).
+		bool feed(const char* data, size_t size, const std::function<bool(nlohmann::json&& record)>& onRecord) {
+			const char* end = data + size;
+			while (data < end) {
+				// memchr is vectorized by the C runtime, so long lines are scanned 16+ bytes at a time
+				const char* newline = static_cast<const char*>(std::memchr(data, '\n', static_cast<size_t>(end - data)));
+				const char* lineEnd = newline ? newline : end;
+				if (partial_.size() + static_cast<size_t>(lineEnd - data) > options_.max_line_size) {
+					error_ = "JSON line " + std::to_string(line_number_ + 1) + " exceeds max_line_size.";
+					return false;
+				}
+				if (!newline) {
+					partial_.append(data, end);
+					break;
+				}
+				bool keepGoing;
+				if (partial_.empty()) {
+					keepGoing = handleLine(data, newline, onRecord);
+				}
+				else {
+					partial_.append(data, newline);
+					keepGoing = handleLine(partial_.data(), partial_.data() + partial_.size(), onRecord);
+					partial_.clear();
+				}
+				if (!keepGoing) return false;
+				data = newline + 1;
+			}
+			return true;
+		}
+
+		// Parses the last record, which need not end with a newline. Returns false like feed.
+		bool finish(const std::function<bool(nlohmann::json&& record)>& onRecord) {
+			if (partial_.empty()) return true;
+			bool keepGoing = handleLine(partial_.data(), partial_.data() + partial_.size(), onRecord);
+			partial_.clear();
+			return keepGoing;
+		}
+
+		// True once onRecord has returned false
+		bool stopped() const { return stopped_; }
+
+		// Why parsing failed; empty unless a line was invalid or too long
+		const std::string& error() const { return error_; }
+
+	private:
+		// Parses one line; blank lines are allowed between records
+		bool handleLine(const char* begin, const char* end, const std::function<bool(nlohmann::json&& record)>& onRecord) {
+			++line_number_;
+			if (end > begin && end[-1] == '\r') --end;
+			if (std::all_of(begin, end, [](unsigned char c) { return std::isspace(c); })) return true;
+			nlohmann::json record = nlohmann::json::parse(begin, end, nullptr, false);
+			if (record.is_discarded()) {
+				if (options_.skip_invalid) return true;
+				error_ = "Invalid JSON on line " + std::to_string(line_number_) + ".";
+				return false;
+			}
+			if (!onRecord(std::move(record))) {
+				stopped_ = true;
+				return false;
+			}
+			return true;
+		}
+
+		JsonLinesOptions options_;
+		std::string partial_;
+		size_t line_number_ = 0;
+		bool stopped_ = false;
+		std::string error_;
+	};
+
+	// An event received from a text/event-stream response
+	struct ServerSentEvent {
+		std::string event = "message";
+		std::string data;
+		std::string id; // Last event ID in effect when the event was dispatched
+	};
+
+	// Controls HttpClient::streamEvents
+	struct EventStreamOptions {
+		std::chrono::milliseconds retry{ 3000 };     // Reconnect delay until the server sends "retry:"
+		std::chrono::milliseconds max_retry{ 60000 }; // Cap for the delay as consecutive failures double it
+		int max_reconnects = -1;                      // -1 reconnects forever
+		size_t max_event_size = 1024 * 1024;          // Longer lines or events fail the stream
+	};
+
+	// Incremental parser for the event stream format (HTML Living Standard, 9.2.6).
+	// Keeps only the current line and event, so memory stays flat on endless streams.
+	class EventStreamParser {
+	public:
+		explicit EventStreamParser(size_t maxEventSize = 1024 * 1024) : max_event_size_(maxEventSize) {}
+
+		// Feeds a chunk; onEvent returning false stops parsing. Returns false when
+		// parsing stopped or an event outgrew maxEventSize (see overflowed).
+		bool feed(const char* data, size_t size, const std::function<bool(const ServerSentEvent&)>& onEvent) {
+			const char* end = data + size;
+			while (data < end) {
+				if (skip_lf_) {
+					skip_lf_ = false;
+					if (*data == '\n') {
+						++data;
+						continue;
+					}
+				}
+				const char* eol = data;
+				while (eol < end && *eol != '\n' && *eol != '\r') ++eol;
+				line_.append(data, eol);
+				if (line_.size() + event_.data.size() > max_event_size_) {
+					overflowed_ = true;
+					return false;
+				}
+				if (eol == end) break;
+				// CRLF may be split across chunks; remember to drop the LF
+				skip_lf_ = *eol == '\r';
+				data = eol + 1;
+				if (!processLine(onEvent)) return false;
+			}
+			return true;
+		}
+
+		// ID to send as Last-Event-ID when reconnecting
+		const std::string& lastEventId() const { return last_event_id_; }
+
+		// Reconnection time requested by the server, if any
+		std::optional<std::chrono::milliseconds> retry() const { return retry_; }
+
+		bool overflowed() const { return overflowed_; }
+
+		// Forgets any partial line and event, as required after a reconnect
+		void reset() {
+			line_.clear();
+			event_ = ServerSentEvent();
+			skip_lf_ = false;
+			first_line_ = true;
+		}
+
+	private:
+		bool processLine(const std::function<bool(const ServerSentEvent&)>& onEvent) {
+			std::string_view line = line_;
+			if (first_line_) {
+				first_line_ = false;
+				if (line.substr(0, 3) == "\xEF\xBB\xBF") line.remove_prefix(3);
+			}
+			bool keepGoing = true;
+			if (line.empty()) {
+				keepGoing = dispatch(onEvent);
+			}
+			else if (line[0] != ':') {
+				auto colon = line.find(':');
+				std::string_view field = line.substr(0, colon);
+				std::string_view value = colon == std::string_view::npos ? std::string_view() : line.substr(colon + 1);
+				if (!value.empty() && value[0] == ' ') value.remove_prefix(1);
+				if (field == "data") {
+					event_.data.append(value.data(), value.size());
+					event_.data.push_back('\n');
+				}
+				else if (field == "event") {
+					event_.event.assign(value.data(), value.size());
+				}
+				else if (field == "id") {
+					if (value.find('\0') == std::string_view::npos) last_event_id_.assign(value.data(), value.size());
+				}
+				else if (field == "retry") {
+					if (!value.empty() && std::all_of(value.begin(), value.end(), [](unsigned char c) { return std::isdigit(c); })) {
+						retry_ = std::chrono::milliseconds{ std::strtoll(std::string(value).c_str(), nullptr, 10) };
+					}
+				}
+			}
+			line_.clear();
+			return keepGoing;
+		}
+
+		bool dispatch(const std::function<bool(const ServerSentEvent&)>& onEvent) {
+			bool keepGoing = true;
+			if (!event_.data.empty()) {
+				event_.data.pop_back(); // Drop the newline after the last data line
+				if (event_.event.empty()) event_.event = "message";
+				event_.id = last_event_id_;
+				keepGoing = onEvent(event_);
+			}
+			event_ = ServerSentEvent();
+			return keepGoing;
+		}
+
+		size_t max_event_size_;
+		std::string line_;
+		ServerSentEvent event_;
+		std::string last_event_id_;
+		std::optional<std::chrono::milliseconds> retry_;
+		bool skip_lf_ = false;
+		bool first_line_ = true;
+		bool overflowed_ = false;
+	};
+
+	enum class WebSocketMessageType { Text, Binary };
+
+	struct WebSocketMessage {
+		WebSocketMessageType type = WebSocketMessageType::Text;
+		std::string data;
+	};
+
+	// Controls WebSocket connections opened by HttpClient::openWebSocket
+	struct WebSocketOptions {
+		std::chrono::milliseconds keepalive_interval{ 30000 }; // Ping interval, at least 15000; WinHTTP answers pings itself
+		size_t max_message_size = 16 * 1024 * 1024;            // Larger incoming messages close the socket with 1009
+	};
+
+	// An open WebSocket connection (RFC 6455). WinHTTP handles framing, masking
+	// and control frames. One thread may send while another receives.
+	class WebSocket {
+	public:
+		WebSocket(WinHttpHandle socket, std::shared_ptr<ConnectionPool> pool, size_t maxMessageSize)
+			: socket_(std::move(socket)), pool_(std::move(pool)), max_message_size_(maxMessageSize) {}
+
+		~WebSocket() {
+			if (open_) {
+				close(WINHTTP_WEB_SOCKET_ENDPOINT_TERMINATED_CLOSE_STATUS);
+			}
+		}
+
+		// Disable copy
+		WebSocket(const WebSocket&) = delete;
+		WebSocket& operator=(const WebSocket&) = delete;
+
+		// Sends a complete message; false if the socket failed or is closed
+		bool send(std::string_view data, WebSocketMessageType type = WebSocketMessageType::Text) {
+			return sendFrame(data, type, true);
+		}
+
+		// Sends one fragment of a message; the last fragment passes final = true
+		bool sendFragment(std::string_view data, WebSocketMessageType type, bool final) {
+			return sendFrame(data, type, final);
+		}
+
+		// Waits for the next complete message, reassembling fragments. Returns
+		// nullopt once the peer closes or the connection fails; see closeStatus and error.
+		std::optional<WebSocketMessage> receive() {
+			std::lock_guard<std::mutex> lock(receive_mutex_);
+			WebSocketMessage message;
+			char buffer[16 * 1024];
+			for (;;) {
+				if (!open_) return std::nullopt;
+				DWORD received = 0;
+				WINHTTP_WEB_SOCKET_BUFFER_TYPE type;
+				DWORD result = WinHttpWebSocketReceive(socket_.get(), buffer, sizeof(buffer), &received, &type);
+				if (result != NO_ERROR) {
+					fail("WinHttpWebSocketReceive failed.");
+					return std::nullopt;
+				}
+				if (type == WINHTTP_WEB_SOCKET_CLOSE_BUFFER_TYPE) {
+					// Record the peer's status and complete the closing handshake
+					USHORT status = 0;
+					char reason[123];
+					DWORD reasonLength = 0;
+					if (WinHttpWebSocketQueryCloseStatus(socket_.get(), &status, reason, sizeof(reason), &reasonLength) == NO_ERROR) {
+						std::lock_guard<std::mutex> state(state_mutex_);
+						close_status_ = status;
+						close_reason_.assign(reason, reasonLength);
+					}
+					// 1005, 1006 and 1015 describe the connection and must never be sent in a close frame
+					bool reserved = status == 0 || status == WINHTTP_WEB_SOCKET_EMPTY_CLOSE_STATUS ||
+						status == WINHTTP_WEB_SOCKET_ABORTED_CLOSE_STATUS ||
+						status == WINHTTP_WEB_SOCKET_SECURE_HANDSHAKE_ERROR_CLOSE_STATUS;
+					close(reserved ? static_cast<USHORT>(WINHTTP_WEB_SOCKET_SUCCESS_CLOSE_STATUS) : status);
+					return std::nullopt;
+				}
+				if (message.data.size() + received > max_message_size_) {
+					close(1009, "Message too big");
+					fail("Incoming WebSocket message exceeds max_message_size.");
+					return std::nullopt;
+				}
+				message.data.append(buffer, received);
+				message.type = (type == WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE || type == WINHTTP_WEB_SOCKET_UTF8_FRAGMENT_BUFFER_TYPE)
+					? WebSocketMessageType::Text : WebSocketMessageType::Binary;
+				if (type == WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE || type == WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE) {
+					return message;
+				}
+			}
+		}
+
+		// Starts the closing handshake; further sends fail
+		bool close(unsigned short status = WINHTTP_WEB_SOCKET_SUCCESS_CLOSE_STATUS, const std::string& reason = "") {
+			if (!open_.exchange(false)) return false;
+			// Close reasons are limited to 123 bytes so the frame fits in a control frame
+			std::string trimmed = reason.substr(0, 123);
+			return WinHttpWebSocketClose(socket_.get(), status,
+				trimmed.empty() ? NULL : (PVOID)trimmed.data(), static_cast<DWORD>(trimmed.size())) == NO_ERROR;
+		}
+
+		bool isOpen() const { return open_; }
+
+		// Close status sent by the peer, or 0 if it has not closed
+		unsigned short closeStatus() const {
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			return close_status_;
+		}
+
+		std::string closeReason() const {
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			return close_reason_;
+		}
+
+		// Describes the last failure, or "" if none
+		std::string error() const {
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			return error_;
+		}
+
+	private:
+		bool sendFrame(std::string_view data, WebSocketMessageType type, bool final) {
+			std::lock_guard<std::mutex> lock(send_mutex_);
+			if (!open_) return false;
+			WINHTTP_WEB_SOCKET_BUFFER_TYPE bufferType = type == WebSocketMessageType::Text
+				? (final ? WINHTTP_WEB_SOCKET_UTF8_MESSAGE_BUFFER_TYPE : WINHTTP_WEB_SOCKET_UTF8_FRAGMENT_BUFFER_TYPE)
+				: (final ? WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE : WINHTTP_WEB_SOCKET_BINARY_FRAGMENT_BUFFER_TYPE);
+			if (WinHttpWebSocketSend(socket_.get(), bufferType, (PVOID)data.data(), static_cast<DWORD>(data.size())) != NO_ERROR) {
+				fail("WinHttpWebSocketSend failed.");
+				return false;
+			}
+			return true;
+		}
+
+		void fail(const std::string& message) {
+			open_ = false;
+			std::lock_guard<std::mutex> lock(state_mutex_);
+			error_ = message;
+		}
+
+		WinHttpHandle socket_;
+		std::shared_ptr<ConnectionPool> pool_; // Keeps the session and connect handle alive
+		size_t max_message_size_;
+		std::atomic<bool> open_{ true };
+		std::mutex send_mutex_;
+		std::mutex receive_mutex_;
+		mutable std::mutex state_mutex_;
+		unsigned short close_status_ = 0;
+		std::string close_reason_;
+		std::string error_;
+	};
+
+	// The main HttpClient class
+	class HttpClient {
+	public:
+		HttpClient(const std::string& userAgent = "HttpClient/1.0")
+			: user_agent_(userAgent),
+			pool_(std::make_shared<ConnectionPool>(toWideString(userAgent))),
+			retry_budgets_(std::make_shared<RetryBudgets>()),
+			endpoint_groups_(std::make_shared<EndpointGroups>()),
+			redirect_cache_(std::make_shared<RedirectCache>(redirect_policy_.permanent_cache_entries)) {}
+
+		// Sends all requests through the given proxy. Opens a fresh session, so
+		// connections and tunnels pooled under the previous settings are dropped.
+		void setProxy(const ProxyOptions& proxy) {
+			pool_ = std::make_shared<ConnectionPool>(toWideString(user_agent_), proxy, pool_->http2(), pool_->tls(), pool_->socket());
+		}
+
+		const ProxyOptions& proxy() const { return pool_->proxy(); }
+
+		// Enables or disables HTTP/2 (on by default). Opens a fresh session.
+		void setHttp2Enabled(bool enabled) {
+			pool_ = std::make_shared<ConnectionPool>(toWideString(user_agent_), pool_->proxy(), enabled, pool_->tls(), pool_->socket());
+		}
+
+		bool http2Enabled() const { return pool_->http2(); }
+
+		// Sets the TLS protocol versions and certificate checks. Opens a fresh session.
+		void setTlsOptions(const TlsOptions& tls) {
+			pool_ = std::make_shared<ConnectionPool>(toWideString(user_agent_), pool_->proxy(), pool_->http2(), tls, pool_->socket());
+		}
+
+		const TlsOptions& tlsOptions() const { return pool_->tls(); }
+
+		// Sets TCP keep-alive, Fast Open and the per-server connection cap. Opens a fresh session.
+		void setSocketOptions(const SocketOptions& socket) {
+			if (socket.keepalive_time.count() <= 0 || socket.keepalive_interval.count() <= 0) {
+				throw std::invalid_argument("SocketOptions keep-alive durations must be positive");
+			}
+			if (socket.max_connections_per_server < 0) {
+				throw std::invalid_argument("SocketOptions::max_connections_per_server must not be negative");
+			}
+			pool_ = std::make_shared<ConnectionPool>(toWideString(user_agent_), pool_->proxy(), pool_->http2(), pool_->tls(), socket);
+		}
+
+		const SocketOptions& socketOptions() const { return pool_->socket(); }
+
+		// Sets the retry policy applied to idempotent requests
+		void setRetryPolicy(const RetryPolicy& policy) {
+			retry_policy_ = policy;
+			retry_budgets_ = std::make_shared<RetryBudgets>();
+		}
+
+		const RetryPolicy& retryPolicy() const { return retry_policy_; }
+
+		// Sets the client's per-phase and total timeouts; a TimeoutScope overrides them per request
+		void setTimeoutPolicy(const TimeoutPolicy& policy) {
+			for (auto phase : { policy.connect, policy.tls_handshake, policy.first_byte, policy.read_idle, policy.total }) {
+				if (phase.count() < 0) {
+					throw std::invalid_argument("TimeoutPolicy durations must not be negative");
+				}
+			}
+			timeout_policy_ = policy;
+		}
+
+		const TimeoutPolicy& timeoutPolicy() const { return timeout_policy_; }
+
+		// Enables per-host circuit breaking; resets all breaker state
+		void setCircuitBreakerPolicy(const CircuitBreakerPolicy& policy) {
+			circuit_breakers_ = policy.enabled ? std::make_shared<CircuitBreakers>(policy) : nullptr;
+		}
+
+		// Enables per-host adaptive concurrency limiting; resets all limiter state
+		void setConcurrencyLimitPolicy(const ConcurrencyLimitPolicy& policy) {
+			concurrency_limiters_ = policy.enabled ? std::make_shared<ConcurrencyLimiters>(policy) : nullptr;
+		}
+
+		// Maps a logical host name to a set of backend base URLs (scheme://host[:port]).
+		// Requests whose URL host equals name are balanced across the backends.
+		void addEndpointGroup(const std::string& name, const std::vector<std::string>& backendUrls,
+			const EndpointGroupPolicy& policy = {}) {
+			if (backendUrls.empty()) {
+				throw std::invalid_argument("Endpoint group requires at least one backend.");
+			}
+			std::vector<EndpointGroup::Backend> backends;
+			for (const auto& backendUrl : backendUrls) {
+				EndpointGroup::Backend backend;
+				std::string path;
+				if (!parseUrl(backendUrl, backend.scheme, backend.host, backend.port, path)) {
+					throw std::invalid_argument("Invalid backend URL: " + backendUrl);
+				}
+				backends.push_back(std::move(backend));
+			}
+			endpoint_groups_->add(name, std::make_shared<EndpointGroup>(std::move(backends), policy));
+		}
+
+		void removeEndpointGroup(const std::string& name) {
+			endpoint_groups_->remove(name);
+		}
+
+		// Returns the group registered under name, or nullptr
+		std::shared_ptr<const EndpointGroup> endpointGroup(const std::string& name) const {
+			return endpoint_groups_->find(name);
+		}
+
+		// Enables the response cache for GET requests; clears in-memory entries.
+		// Throws if the disk tier directory cannot be created or mapped.
+		void setResponseCacheOptions(const ResponseCacheOptions& options) {
+			response_cache_ = nullptr; // Releases the disk directory before a new cache claims it
+			response_cache_ = options.enabled ? std::make_shared<ResponseCache>(options) : nullptr;
+		}
+
+		// Downloads url into sink over up to `segments` concurrent Range requests.
+		// The object is probed with HEAD (or a one-byte Range GET), split into
+		// byte ranges, and each range is written at its offset as it arrives.
+		// Interrupted ranges resume from their last received byte; If-Range
+		// guards against the object changing mid-transfer. Servers without
+		// range support get a single streamed GET.
+		HttpResponse downloadParallel(const std::string& url, DownloadSink& sink, int segments = 4,
+			const std::unordered_map<std::string, std::string>& headers = {}, std::stop_token stop = {}) const {
+			detail::StopScope cancel(std::move(stop));
+			HttpResponse probe = probeDownload(url, headers);
+			if (!probe.error.empty()) {
+				return probe;
+			}
+
+			// Range requests go straight to wherever the probe was redirected
+			const std::string target = probe.url.empty() ? url : probe.url;
+			uint64_t total = 0;
+			bool ranged = false;
+			std::string validator;
+			describeDownload(probe, total, ranged, validator);
+			if (!ranged || total == 0) {
+				return downloadSingle(target, sink, headers, probe, total);
+			}
+			if (!sink.prepare(total)) {
+				probe.error = "Failed to prepare download sink.";
+				probe.error_kind = ErrorKind::Aborted;
+				return probe;
+			}
+
+			uint64_t minSegment = (std::max<uint64_t>)(1, download_options_.min_segment_bytes);
+			uint64_t count = std::clamp<uint64_t>(total / minSegment, 1, static_cast<uint64_t>((std::max)(1, segments)));
+			std::vector<std::pair<uint64_t, uint64_t>> ranges;
+			for (uint64_t i = 0; i < count; ++i) {
+				uint64_t first = total * i / count;
+				uint64_t last = total * (i + 1) / count - 1;
+				ranges.emplace_back(first, last);
+			}
+			return downloadRanges(target, sink, headers, probe, ranges, validator, nullptr);
+		}
+
+		// Downloads url to path, resuming an earlier interrupted download if possible.
+		// Data goes to "<path>.part" and completed byte ranges are journaled in
+		// "<path>.journal", so a failed transfer or a process restart continues
+		// where it stopped. The journal records the ETag or Last-Modified of the
+		// object; if it no longer matches, the download starts over. On success
+		// the part file is renamed to path and the journal is removed.
+		HttpResponse downloadResumable(const std::string& url, const std::string& path, int segments = 4,
+			const std::unordered_map<std::string, std::string>& headers = {}, std::stop_token stop = {}) const {
+			detail::StopScope cancel(std::move(stop));
+			const std::string partPath = path + ".part";
+			const std::string journalPath = path + ".journal";
+
+			HttpResponse probe = probeDownload(url, headers);
+			if (!probe.error.empty()) {
+				return probe;
+			}
+			// Range requests go straight to wherever the probe was redirected
+			const std::string target = probe.url.empty() ? url : probe.url;
+			uint64_t total = 0;
+			bool ranged = false;
+			std::string validator;
+			describeDownload(probe, total, ranged, validator);
+
+			HttpResponse result;
+			if (!ranged || total == 0 || validator.empty()) {
+				// Without ranges and a validator there is no safe way to resume
+				std::error_code ec;
+				std::filesystem::remove(detail::pathFromUtf8(journalPath), ec);
+				std::filesystem::remove(detail::pathFromUtf8(partPath), ec);
+				FileSink sink(partPath);
+				result = downloadSingle(target, sink, headers, probe, total);
+				sink.close();
+			}
+			else {
+				std::vector<std::pair<uint64_t, uint64_t>> done;
+				if (!readJournal(journalPath, total, validator, done) ||
+					!std::filesystem::exists(detail::pathFromUtf8(partPath))) {
+					done.clear();
+				}
+				std::vector<std::pair<uint64_t, uint64_t>> ranges = missingRanges(done, total, segments);
+
+				FileSink sink(partPath);
+				if (!sink.prepare(total)) {
+					probe.error = "Failed to prepare download file.";
+					probe.error_kind = ErrorKind::Aborted;
+					return probe;
+				}
+				// Start a compacted journal holding only what is already on disk
+				std::ofstream journal(detail::pathFromUtf8(journalPath), std::ios::binary | std::ios::trunc);
+				journal << "HttpClient-journal 1\n" << total << "\n" << validator << "\n";
+				for (const auto& range : done) {
+					journal << range.first << " " << range.second << "\n";
+				}
+				journal.flush();
+				if (!journal) {
+					probe.error = "Failed to write download journal.";
+					probe.error_kind = ErrorKind::Aborted;
+					return probe;
+				}
+
+				std::mutex journalMutex;
+				std::vector<std::pair<uint64_t, uint64_t>> pending;
+				uint64_t pendingBytes = 0;
+				auto checkpoint = [&]() {
+					// Flush data before journaling it so the journal never claims bytes that are not on disk
+					if (pending.empty() || !sink.flush()) return;
+					for (const auto& range : mergeRanges(std::move(pending))) {
+						journal << range.first << " " << range.second << "\n";
+					}
+					journal.flush();
+					pending.clear();
+					pendingBytes = 0;
+				};
+				auto onProgress = [&](uint64_t offset, uint64_t size) {
+					std::lock_guard<std::mutex> lock(journalMutex);
+					pending.emplace_back(offset, offset + size - 1);
+					pendingBytes += size;
+					if (pendingBytes >= download_options_.journal_checkpoint_bytes) {
+						checkpoint();
+					}
+				};
+
+				result = downloadRanges(target, sink, headers, probe, ranges, validator, onProgress);
+				checkpoint();
+				journal.close();
+				sink.close();
+			}
+
+			if (!result.error.empty()) {
+				return result;
+			}
+			std::error_code ec;
+			std::filesystem::rename(detail::pathFromUtf8(partPath), detail::pathFromUtf8(path), ec);
+			if (ec) {
+				result.error = "Failed to move completed download into place: " + ec.message();
+				result.error_kind = ErrorKind::Aborted;
+				return result;
+			}
+			std::filesystem::remove(detail::pathFromUtf8(journalPath), ec);
+			return result;
+		}
+
+		void setDownloadOptions(const DownloadOptions& options) { download_options_ = options; }
+
+		// Enables coalescing of concurrent identical GET and HEAD requests. With zeroCopy,
+		// callers share one body buffer through bodyView() and leave body empty.
+		void setRequestCoalescing(bool enabled, bool zeroCopy = false) {
+			single_flight_ = enabled ? std::make_shared<SingleFlight>(zeroCopy) : nullptr;
+		}
+
+		// Returns cache counters; all zero when the cache is disabled
+		ResponseCacheStats cacheStats() const {
+			return response_cache_ ? response_cache_->stats() : ResponseCacheStats();
+		}
+
+		// Returns a snapshot of per-origin state, keyed by "host:port"
+		std::unordered_map<std::string, HostMetrics> metrics() const {
+			std::unordered_map<std::string, HostMetrics> result;
+			if (circuit_breakers_) {
+				circuit_breakers_->fillMetrics(result);
+			}
+			if (concurrency_limiters_) {
+				concurrency_limiters_->fillMetrics(result);
+			}
+			return result;
+		}
+
+		HttpResponse get(const std::string& url, const std::unordered_map<std::string, std::string>& headers = {},
+			std::stop_token stop = {}) const {
+			return sendRequest("GET", url, "", headers, std::move(stop));
+		}
+
+		HttpResponse post(const std::string& url, const std::string& data, const std::unordered_map<std::string, std::string>& headers = {},
+			std::stop_token stop = {}) const {
+			return sendRequest("POST", url, data, headers, std::move(stop));
+		}
+
+		HttpResponse put(const std::string& url, const std::string& data, const std::unordered_map<std::string, std::string>& headers = {},
+			std::stop_token stop = {}) const {
+			return sendRequest("PUT", url, data, headers, std::move(stop));
+		}
+
+		HttpResponse patch(const std::string& url, const std::string& data, const std::unordered_map<std::string, std::string>& headers = {},
+			std::stop_token stop = {}) const {
+			return sendRequest("PATCH", url, data, headers, std::move(stop));
+		}
+
+		HttpResponse del(const std::string& url, const std::unordered_map<std::string, std::string>& headers = {},
+			std::stop_token stop = {}) const {
+			return sendRequest("DELETE", url, "", headers, std::move(stop));
+		}
+
+		HttpResponse head(const std::string& url, const std::unordered_map<std::string, std::string>& headers = {},
+			std::stop_token stop = {}) const {
+			return sendRequest("HEAD", url, "", headers, std::move(stop));
+		}
+
+		HttpResponse options(const std::string& url, const std::unordered_map<std::string, std::string>& headers = {},
+			std::stop_token stop = {}) const {
+			return sendRequest("OPTIONS", url, "", headers, std::move(stop));
+		}
+
+		// Consumes a Server-Sent Events stream, calling onEvent for each event as it
+		// arrives. Reconnects after disconnects, sending Last-Event-ID and waiting
+		// the server's "retry:" delay (doubled on consecutive failures). Returns when
+		// onEvent returns false, the server answers 204, a response is not an event
+		// stream, max_reconnects is exhausted, or stop is requested.
+		HttpResponse streamEvents(const std::string& url, const std::function<bool(const ServerSentEvent&)>& onEvent,
+			const std::unordered_map<std::string, std::string>& headers = {},
+			const EventStreamOptions& options = {}, std::stop_token stop = {}) const {
+			detail::StopScope cancel(std::move(stop));
+			EventStreamParser parser(options.max_event_size);
+			// The stream is meant to stay open, so the total timeout does not apply to it
+			TimeoutPolicy streamTimeouts = currentTimeouts();
+			streamTimeouts.total = std::chrono::milliseconds{ 0 };
+			TimeoutScope scope(streamTimeouts);
+			std::chrono::milliseconds delay{ 0 };
+			HttpResponse response;
+			for (int reconnects = 0;; ++reconnects) {
+				auto streamHeaders = headers;
+				streamHeaders["Accept"] = "text/event-stream";
+				streamHeaders["Cache-Control"] = "no-cache";
+				if (!parser.lastEventId().empty()) {
+					streamHeaders["Last-Event-ID"] = parser.lastEventId();
+				}
+
+				bool stopped = false;
+				bool received = false;
+				parser.reset();
+				response = sendStreaming("GET", url, streamHeaders,
+					[&](const HttpResponse& head, const char* data, size_t size) {
+						if (head.status_code != 200 ||
+							detail::toLower(head.getHeader("Content-Type")).find("text/event-stream") == std::string::npos) {
+							return false;
+						}
+						received = true;
+						return parser.feed(data, size, [&](const ServerSentEvent& event) {
+							if (!onEvent(event)) stopped = true;
+							return !stopped;
+						});
+					});
+
+				if (stopped) {
+					response.error.clear();
+					response.error_kind = ErrorKind::None;
+					return response;
+				}
+				if (response.error_kind == ErrorKind::Cancelled) {
+					return response;
+				}
+				if (parser.overflowed()) {
+					response.error = "Event stream line or event exceeds max_event_size.";
+					response.error_kind = ErrorKind::Aborted;
+					return response;
+				}
+				// 204 tells the client to stop. Gateway errors are retried like dropped
+				// connections; any other status or content type fails the stream.
+				int status = response.status_code;
+				if (status == 204) {
+					response.error.clear();
+					response.error_kind = ErrorKind::None;
+					return response;
+				}
+				bool wrongType = status == 200 &&
+					detail::toLower(response.getHeader("Content-Type")).find("text/event-stream") == std::string::npos;
+				if (wrongType || (status != 0 && status != 200 && status != 502 && status != 503 && status != 504)) {
+					response.error = wrongType ? "Response is not an event stream."
+						: "Event stream failed with status " + std::to_string(status) + ".";
+					response.error_kind = ErrorKind::None;
+					return response;
+				}
+				if (options.max_reconnects >= 0 && reconnects >= options.max_reconnects) {
+					if (response.error.empty()) response.error = "Event stream ended.";
+					return response;
+				}
+				// A read_idle timeout reconnects like a dropped connection, but a spent deadline is final
+				auto remaining = TimeoutScope::remaining();
+				if (remaining && remaining->count() == 0) {
+					if (response.error_kind != ErrorKind::Timeout) {
+						response.error = "Request deadline exceeded.";
+						response.error_kind = ErrorKind::Timeout;
+					}
+					return response;
+				}
+
+				// A stream that delivered data resets the backoff. The server's "retry:" is capped
+				// too, and the doubling stops at the cap so it cannot overflow.
+				std::chrono::milliseconds base = (std::min)(options.max_retry, parser.retry().value_or(options.retry));
+				std::chrono::milliseconds doubled = delay > options.max_retry / 2 ? options.max_retry : delay * 2;
+				delay = received ? base : (std::min)(options.max_retry, (std::max)(base, doubled));
+				if (!detail::sleepUnlessStopped(delay)) {
+					return cancelledResponse();
+				}
+			}
+		}
+
+		// Streams a newline-delimited JSON (NDJSON / JSON Lines) response, calling
+		// onRecord with each parsed record as soon as its line is complete. Only a
+		// partial line is ever buffered. onRecord returning false stops the transfer.
+		HttpResponse streamJsonLines(const std::string& url, const std::function<bool(nlohmann::json&& record)>& onRecord,
+			const std::unordered_map<std::string, std::string>& headers = {},
+			const JsonLinesOptions& options = {}, std::stop_token stop = {}) const {
+			detail::StopScope cancel(std::move(stop));
+			JsonLinesParser parser(options);
+
+			auto streamHeaders = headers;
+			if (!detail::findHeader(streamHeaders, "Accept")) {
+				streamHeaders["Accept"] = "application/x-ndjson, application/jsonl, application/json";
+			}
+			HttpResponse response = sendStreaming("GET", url, streamHeaders,
+				[&](const HttpResponse& head, const char* data, size_t size) {
+					return head.is_success() && parser.feed(data, size, onRecord);
+				});
+
+			if (parser.stopped()) {
+				response.error.clear();
+				response.error_kind = ErrorKind::None;
+				return response;
+			}
+			if (!parser.error().empty()) {
+				response.error = parser.error();
+				response.error_kind = ErrorKind::Aborted;
+				return response;
+			}
+			if (response.error.empty() && !response.is_success()) {
+				response.error = "JSON lines request failed with status " + std::to_string(response.status_code) + ".";
+				return response;
+			}
+			// The last record need not end with a newline
+			if (response.error.empty() && !parser.finish(onRecord) && !parser.stopped()) {
+				response.error = parser.error();
+				response.error_kind = ErrorKind::Aborted;
+			}
+			return response;
+		}
+
+		// Opens a WebSocket to a ws:// or wss:// URL. Returns the handshake response;
+		// on success its status is 101 and socket holds the open connection.
+		HttpResponse openWebSocket(const std::string& url, std::unique_ptr<WebSocket>& socket,
+			const std::unordered_map<std::string, std::string>& headers = {},
+			const WebSocketOptions& options = {}, std::stop_token stop = {}) const {
+			HttpResponse response;
+			response.error_kind = ErrorKind::InvalidRequest;
+			std::string httpUrl = url;
+			if (url.rfind("ws://", 0) == 0) httpUrl = "http://" + url.substr(5);
+			else if (url.rfind("wss://", 0) == 0) httpUrl = "https://" + url.substr(6);
+			std::string scheme, host, path;
+			unsigned short port;
+			if (!parseUrl(httpUrl, scheme, host, port, path)) {
+				response.error = "Invalid URL format.";
+				return response;
+			}
+			// WinHTTP rejects shorter keep-alive intervals
+			if (options.keepalive_interval < std::chrono::milliseconds{ 15000 }) {
+				response.error = "WebSocket keepalive_interval must be at least 15000 ms.";
+				return response;
+			}
+
+			response.error_kind = ErrorKind::Transport;
+			try {
+				bool isHttps = scheme == "https";
+				HINTERNET hConnect = pool_->connect(toWideString(host), port);
+				if (!hConnect) {
+					response.error = pool_->session() ? "WinHttpConnect failed." : "WinHttpOpen failed.";
+					return response;
+				}
+				WinHttpHandle hRequest(WinHttpOpenRequest(hConnect, L"GET", toWideString(path).c_str(), NULL,
+					WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, isHttps ? WINHTTP_FLAG_SECURE : 0));
+				if (!hRequest.get()) {
+					response.error = "WinHttpOpenRequest failed.";
+					return response;
+				}
+				if (!WinHttpSetOption(hRequest.get(), WINHTTP_OPTION_UPGRADE_TO_WEB_SOCKET, NULL, 0)) {
+					response.error = "WebSocket upgrade is not supported on this system.";
+					return response;
+				}
+				DWORD keepalive = static_cast<DWORD>((std::min<long long>)(options.keepalive_interval.count(), MAXDWORD));
+				if (!WinHttpSetOption(hRequest.get(), WINHTTP_OPTION_WEB_SOCKET_KEEPALIVE_INTERVAL, &keepalive, sizeof(keepalive))) {
+					response.error = "Setting the WebSocket keep-alive interval failed.";
+					return response;
+				}
+
+				std::wstring headerString = prepareRequest(hRequest.get(), host, path, isHttps, headers);
+				if (!headerString.empty() && !WinHttpAddRequestHeaders(hRequest.get(), headerString.c_str(),
+					static_cast<DWORD>(headerString.length()), WINHTTP_ADDREQ_FLAG_ADD)) {
+					response.error = "WinHttpAddRequestHeaders failed.";
+					return response;
+				}
+				// Only the handshake can be stopped; an open socket is ended with WebSocket::close
+				bool handshakeDone = false;
+				{
+					detail::RequestWatch watch(hRequest, std::nullopt, stop);
+					// A stop closes the handle, so it is checked before every further call on it
+					auto live = [&]() { return watch.reason() == detail::RequestWatch::Reason::None; };
+					if (!live() || !WinHttpSendRequest(hRequest.get(), WINHTTP_NO_ADDITIONAL_HEADERS, 0, NULL, 0, 0, 0)) {
+						response.error = "WinHttpSendRequest failed.";
+					}
+					else if (!live() || !WinHttpReceiveResponse(hRequest.get(), NULL)) {
+						response.error = "WinHttpReceiveResponse failed.";
+					}
+					else {
+						handshakeDone = readResponseHead(hRequest.get(), host, path, response, &watch);
+					}
+					if (watch.reason() == detail::RequestWatch::Reason::Stopped) {
+						return cancelledResponse();
+					}
+				}
+				if (!handshakeDone) {
+					return response;
+				}
+				response.error_kind = ErrorKind::None;
+				if (response.status_code != 101) {
+					response.error = "WebSocket upgrade refused with status " + std::to_string(response.status_code) + ".";
+					return response;
+				}
+
+				WinHttpHandle hSocket(WinHttpWebSocketCompleteUpgrade(hRequest.get(), 0));
+				if (!hSocket.get()) {
+					response.error = "WinHttpWebSocketCompleteUpgrade failed.";
+					response.error_kind = ErrorKind::Transport;
+					return response;
+				}
+				socket = std::make_unique<WebSocket>(std::move(hSocket), pool_, options.max_message_size);
+			}
+			catch (const std::exception& ex) {
+				response.error = ex.what();
+				response.error_kind = ErrorKind::InvalidRequest;
+			}
+			return response;
+		}
+
+		// Sends a multipart/form-data POST, streaming file and callback parts instead of buffering them
+		HttpResponse postMultipart(const std::string& url, const MultipartForm& form,
+			const std::unordered_map<std::string, std::string>& headers = {}, std::stop_token stop = {}) const {
+			detail::StopScope cancel(std::move(stop));
+			std::string scheme, host, path;
+			unsigned short port;
+			if (!parseUrl(url, scheme, host, port, path)) {
+				HttpResponse response;
+				response.error = "Invalid URL format.";
+				response.error_kind = ErrorKind::InvalidRequest;
+				return response;
+			}
+			UploadBody upload;
+			try {
+				upload = form.body();
+			}
+			catch (const std::exception& ex) {
+				HttpResponse response;
+				response.error = ex.what();
+				response.error_kind = ErrorKind::InvalidRequest;
+				return response;
+			}
+			auto headersWithContentType = headers;
+			headersWithContentType["Content-Type"] = form.contentType();
+			std::optional<TimeoutScope> total;
+			startTotalTimeout(total);
+			return sendParsed("POST", scheme, host, port, path, "", headersWithContentType, &upload);
+		}
+
+		// Sets how redirects are followed; clears remembered permanent redirects
+		void setRedirectPolicy(const RedirectPolicy& policy) {
+			if (policy.max_redirects < 0) {
+				throw std::invalid_argument("RedirectPolicy::max_redirects must not be negative");
+			}
+			redirect_policy_ = policy;
+			redirect_cache_ = policy.follow && policy.cache_permanent && policy.permanent_cache_entries > 0
+				? std::make_shared<RedirectCache>(policy.permanent_cache_entries) : nullptr;
+		}
+
+		const RedirectPolicy& redirectPolicy() const { return redirect_policy_; }
+
+		// Attaches a cookie jar: matching cookies are sent with each request and
+		// Set-Cookie responses are stored. Pass nullptr to stop handling cookies.
+		void setCookieJar(std::shared_ptr<CookieJar> jar) { cookie_jar_ = std::move(jar); }
+		std::shared_ptr<CookieJar> cookieJar() const { return cookie_jar_; }
+
+		// Sends a POST request with JSON data
+		HttpResponse postJson(const std::string& url, const nlohmann::json& jsonData,
+			const std::unordered_map<std::string, std::string>& headers = {}, std::stop_token stop = {}) const {
+			std::string data = jsonData.dump();
+			auto headersWithContentType = headers;
+			headersWithContentType["Content-Type"] = "application/json";
+			return sendRequest("POST", url, data, headersWithContentType, std::move(stop));
+		}
+
+	private:
+		std::string user_agent_;
+		std::shared_ptr<ConnectionPool> pool_;
+		RetryPolicy retry_policy_;
+		TimeoutPolicy timeout_policy_;
+		std::shared_ptr<RetryBudgets> retry_budgets_;
+		std::shared_ptr<CircuitBreakers> circuit_breakers_;
+		std::shared_ptr<ConcurrencyLimiters> concurrency_limiters_;
+		std::shared_ptr<EndpointGroups> endpoint_groups_;
+		std::shared_ptr<ResponseCache> response_cache_;
+		std::shared_ptr<SingleFlight> single_flight_;
+		DownloadOptions download_options_;
+		std::shared_ptr<CookieJar> cookie_jar_;
+		RedirectPolicy redirect_policy_;
+		std::shared_ptr<RedirectCache> redirect_cache_;
+
+		// Converts UTF-8 string to wide string (UTF-16)
+		std::wstring toWideString(const std::string& utf8Str) const {
+			return detail::toWideString(utf8Str);
+		}
+
+		// Converts wide string (UTF-16) to UTF-8 string
+		std::string toUTF8String(const std::wstring& wideStr) const {
+			if (wideStr.empty()) return std::string();
+			int size_needed = WideCharToMultiByte(CP_UTF8, 0, wideStr.c_str(), static_cast<int>(wideStr.length()), NULL, 0, NULL, NULL);
+			if (size_needed == 0) {
+				throw std::runtime_error("Failed to convert wide string to UTF-8 string.");
+			}
+			std::string utf8Str(size_needed, 0);
+			WideCharToMultiByte(CP_UTF8, 0, wideStr.c_str(), static_cast<int>(wideStr.length()), &utf8Str[0], size_needed, NULL, NULL);
+			return utf8Str;
+		}
+
+		// Parses the URL into scheme, host, port, and path (including any query string)
+		bool parseUrl(const std::string& url, std::string& scheme, std::string& host,
+			unsigned short& port, std::string& path) const {
+			return detail::parseUrl(url, scheme, host, port, path);
+		}
+
+		// Sends an HTTP request, consulting the response cache when enabled
+		HttpResponse sendRequest(const std::string& method, const std::string& url,
+			const std::string& data,
+			const std::unordered_map<std::string, std::string>& headers, std::stop_token stop = {}) const {
+			detail::StopScope cancel(std::move(stop));
+			std::string scheme, host, path;
+			unsigned short port;
+			if (!parseUrl(url, scheme, host, port, path)) {
+				HttpResponse response;
+				response.error = "Invalid URL format.";
+				response.error_kind = ErrorKind::InvalidRequest;
+				return response;
+			}
+
+			std::optional<TimeoutScope> total;
+			startTotalTimeout(total);
+			if (single_flight_ && (method == "GET" || method == "HEAD")) {
+				return single_flight_->run(SingleFlight::keyFor(method, scheme, host, port, path, headers),
+					[&]() { return sendFollowingRedirects(method, scheme, host, port, path, data, headers); });
+			}
+			return sendFollowingRedirects(method, scheme, host, port, path, data, headers);
+		}
+
+		// Sends a request and follows redirects per the redirect policy (RFC 9110 section 15.4).
+		// Every hop goes through the cache and the pooled session, so same-origin hops reuse
+		// the open connection; 301/308 targets are remembered and later skipped to directly.
+		HttpResponse sendFollowingRedirects(std::string method, std::string scheme, std::string host,
+			unsigned short port, std::string path, std::string data,
+			std::unordered_map<std::string, std::string> headers, const BodyCallback* onBody = nullptr) const {
+			const RedirectPolicy& policy = redirect_policy_;
+			if (!policy.follow) {
+				return sendParsed(method, scheme, host, port, path, data, headers, nullptr, onBody);
+			}
+
+			bool redirected = false;
+			for (int hops = 0;; ++hops) {
+				std::string from = scheme + "://" + host + ":" + std::to_string(port) + path;
+				std::string next;
+				int status = 0;
+				if (auto cached = redirect_cache_ ? redirect_cache_->find(from) : std::nullopt) {
+					// 301 may turn POST into GET, so only a 308 is taken for other methods
+					if (cached->status_code == 308 || method == "GET" || method == "HEAD") {
+						next = cached->url;
+						status = cached->status_code;
+					}
+				}
+
+				HttpResponse response;
+				if (next.empty()) {
+					response = sendParsed(method, scheme, host, port, path, data, headers, nullptr, onBody);
+					status = response.status_code;
+					bool isRedirect = status == 301 || status == 302 || status == 303 || status == 307 || status == 308;
+					std::string location = response.getHeader("Location");
+					if (!response.error.empty() || !isRedirect || location.empty()) {
+						if (redirected) response.url = formatUrl(scheme, host, port, path);
+						return response;
+					}
+					next = resolveLocation(scheme, host, port, path, location);
+					if ((status == 301 || status == 308) && redirect_cache_) {
+						rememberRedirect(from, next, response);
+					}
+				}
+
+				if (hops >= policy.max_redirects) {
+					if (response.status_code == 0) {
+						// The last hop came from the redirect cache; report it as a redirect response
+						response.status_code = status;
+						response.headers["Location"] = next;
+					}
+					response.error = "Too many redirects.";
+					response.error_kind = ErrorKind::InvalidRequest;
+					return response;
+				}
+
+				std::string nextScheme, nextHost, nextPath;
+				unsigned short nextPort;
+				if (!parseUrl(next, nextScheme, nextHost, nextPort, nextPath) ||
+					(scheme == "https" && nextScheme == "http" && !policy.allow_https_to_http)) {
+					// Not followable; hand the redirect itself back to the caller
+					return response.status_code ? response : sendParsed(method, scheme, host, port, path, data, headers, nullptr, onBody);
+				}
+
+				// 303, and 301/302 after POST, continue as a GET without the body
+				if ((status == 303 && method != "HEAD") || ((status == 301 || status == 302) && method == "POST")) {
+					method = "GET";
+					data.clear();
+					for (auto it = headers.begin(); it != headers.end();) {
+						std::string name = detail::toLower(it->first);
+						it = name.rfind("content-", 0) == 0 || name == "transfer-encoding" ? headers.erase(it) : std::next(it);
+					}
+				}
+				// Credentials are scoped to the origin that was asked for
+				if (nextScheme != scheme || nextHost != host || nextPort != port) {
+					for (auto it = headers.begin(); it != headers.end();) {
+						std::string name = detail::toLower(it->first);
+						it = name == "authorization" || name == "proxy-authorization" || name == "cookie" ? headers.erase(it) : std::next(it);
+					}
+				}
+				scheme = nextScheme;
+				host = nextHost;
+				port = nextPort;
+				path = nextPath;
+				redirected = true;
+			}
+		}
+
+		// Stores a permanent redirect unless its response forbids caching
+		void rememberRedirect(const std::string& from, const std::string& to, const HttpResponse& response) const {
+			auto directives = detail::parseCacheControl(response.getHeader("Cache-Control"));
+			if (directives.count("no-store") || directives.count("no-cache") || directives.count("private")) {
+				return;
+			}
+			std::optional<std::chrono::steady_clock::time_point> expires;
+			auto maxAge = detail::deltaSeconds(directives, "max-age");
+			if (maxAge) {
+				expires = std::chrono::steady_clock::now() + std::chrono::seconds{ *maxAge };
+			}
+			redirect_cache_->store(from, to, response.status_code, expires);
+		}
+
+		// Builds a URL, leaving out the scheme's default port
+		static std::string formatUrl(const std::string& scheme, const std::string& host, unsigned short port,
+			const std::string& path) {
+			bool defaultPort = port == (scheme == "https" ? 443 : 80);
+			return scheme + "://" + host + (defaultPort ? "" : ":" + std::to_string(port)) + path;
+		}
+
+		// True when a reference starts with a scheme (RFC 3986 section 3.1), which must come before any '/', '?' or '#'
+		static bool hasScheme(const std::string& reference) {
+			size_t colon = reference.find_first_of(":/?#");
+			if (colon == std::string::npos || colon == 0 || reference[colon] != ':' ||
+				!std::isalpha(static_cast<unsigned char>(reference[0]))) {
+				return false;
+			}
+			for (size_t i = 1; i < colon; ++i) {
+				char c = reference[i];
+				if (!std::isalnum(static_cast<unsigned char>(c)) && c != '+' && c != '-' && c != '.') {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Resolves a Location header against the request URL (RFC 3986 section 5.2)
+		static std::string resolveLocation(const std::string& scheme, const std::string& host, unsigned short port,
+			const std::string& path, std::string location) {
+			location = location.substr(0, location.find('#'));
+			std::string origin = formatUrl(scheme, host, port, "");
+			if (hasScheme(location)) {
+				return location;
+			}
+			if (location.rfind("//", 0) == 0) {
+				return scheme + ":" + location;
+			}
+			if (location.empty()) {
+				return origin + path;
+			}
+			if (location[0] == '/') {
+				return origin + location;
+			}
+			std::string base = path.substr(0, path.find('?'));
+			if (location[0] == '?') {
+				return origin + base + location;
+			}
+			// Merge with the directory of the current path, then drop dot segments
+			std::string merged = base.substr(0, base.rfind('/') + 1) + location;
+			std::string query;
+			auto q = merged.find('?');
+			if (q != std::string::npos) {
+				query = merged.substr(q);
+				merged.erase(q);
+			}
+			std::vector<std::string> segments;
+			size_t start = 1;
+			while (start <= merged.size()) {
+				size_t slash = merged.find('/', start);
+				std::string segment = merged.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+				bool last = slash == std::string::npos;
+				if (segment == "..") {
+					if (!segments.empty()) segments.pop_back();
+					if (last) segments.push_back("");
+				}
+				else if (segment == ".") {
+					if (last) segments.push_back("");
+				}
+				else {
+					segments.push_back(segment);
+				}
+				if (last) break;
+				start = slash + 1;
+			}
+			std::string resolved;
+			for (const auto& segment : segments) {
+				resolved += "/" + segment;
+			}
+			return origin + (resolved.empty() ? "/" : resolved) + query;
+		}
+
+		// Sends a request whose body is streamed to onBody instead of buffered; bypasses the cache
+		HttpResponse sendStreaming(const std::string& method, const std::string& url,
+			const std::unordered_map<std::string, std::string>& headers, const BodyCallback& onBody,
+			std::stop_token stop = {}) const {
+			detail::StopScope cancel(std::move(stop));
+			std::string scheme, host, path;
+			unsigned short port;
+			if (!parseUrl(url, scheme, host, port, path)) {
+				HttpResponse response;
+				response.error = "Invalid URL format.";
+				response.error_kind = ErrorKind::InvalidRequest;
+				return response;
+			}
+			std::optional<TimeoutScope> total;
+			startTotalTimeout(total);
+			return sendWithRetries(method, scheme, host, port, path, "", headers, &onBody);
+		}
+
+		// The timeout policy in effect for the current thread
+		const TimeoutPolicy& currentTimeouts() const {
+			const TimeoutPolicy* scoped = TimeoutScope::policy();
+			return scoped ? *scoped : timeout_policy_;
+		}
+
+		// Opens the deadline for a whole call when a total timeout is configured
+		void startTotalTimeout(std::optional<TimeoutScope>& scope) const {
+			auto total = currentTimeouts().total;
+			if (total.count() > 0) {
+				scope.emplace(std::chrono::steady_clock::now() + total);
+			}
+		}
+
+		// Learns the size, range support and validator of a download target
+		HttpResponse probeDownload(const std::string& url, const std::unordered_map<std::string, std::string>& headers) const {
+			HttpResponse probe = sendRequest("HEAD", url, "", headers);
+			if (probe.is_success() && !probe.getHeader("Content-Length").empty() &&
+				detail::toLower(probe.getHeader("Accept-Ranges")).find("bytes") != std::string::npos) {
+				return probe;
+			}
+			// Some servers mishandle HEAD; a one-byte range request reveals the same facts
+			std::string scheme, host, path;
+			unsigned short port;
+			if (!parseUrl(url, scheme, host, port, path)) {
+				return probe;
+			}
+			auto rangeHeaders = headers;
+			rangeHeaders["Range"] = "bytes=0-0";
+			// Redirect bodies are drained so the hop can be followed; any other body is cut off at
+			// its first chunk, so a server that ignores the range does not send the whole object
+			BodyCallback stopAtFirstChunk = [](const HttpResponse& response, const char*, size_t) {
+				return response.status_code >= 300 && response.status_code < 400;
+			};
+			std::optional<TimeoutScope> total;
+			startTotalTimeout(total);
+			probe = sendFollowingRedirects("GET", scheme, host, port, path, "", rangeHeaders, &stopAtFirstChunk);
+			if (probe.error_kind == ErrorKind::Aborted && probe.status_code != 0) {
+				probe.error.clear();
+				probe.error_kind = ErrorKind::None;
+			}
+			if (probe.error.empty() && probe.status_code >= 400) {
+				probe.error = "Download probe failed with status " + std::to_string(probe.status_code) + ".";
+			}
+			return probe;
+		}
+
+		// Extracts total size, byte-range support and a strong validator from a probe response
+		static void describeDownload(const HttpResponse& probe, uint64_t& total, bool& ranged, std::string& validator) {
+			total = 0;
+			ranged = false;
+			if (probe.status_code == 206) {
+				// Content-Range: bytes 0-0/12345
+				std::string contentRange = probe.getHeader("Content-Range");
+				auto slash = contentRange.rfind('/');
+				if (slash != std::string::npos && contentRange.compare(slash + 1, std::string::npos, "*") != 0) {
+					total = std::strtoull(contentRange.c_str() + slash + 1, nullptr, 10);
+					ranged = total > 0;
+				}
+			}
+			else {
+				total = std::strtoull(probe.getHeader("Content-Length").c_str(), nullptr, 10);
+				ranged = detail::toLower(probe.getHeader("Accept-Ranges")).find("bytes") != std::string::npos;
+			}
+			// If-Range needs a strong ETag; fall back to Last-Modified
+			std::string etag = probe.getHeader("ETag");
+			validator = (!etag.empty() && etag.rfind("W/", 0) != 0) ? etag : probe.getHeader("Last-Modified");
+		}
+
+		// Streams the whole object with one GET, for servers without range support
+		HttpResponse downloadSingle(const std::string& url, DownloadSink& sink,
+			const std::unordered_map<std::string, std::string>& headers, HttpResponse result, uint64_t total) const {
+			if (!sink.prepare(total)) {
+				result.error = "Failed to prepare download sink.";
+				result.error_kind = ErrorKind::Aborted;
+				return result;
+			}
+			uint64_t offset = 0;
+			HttpResponse response = sendStreaming("GET", url, headers,
+				[&](const HttpResponse& head, const char* data, size_t size) {
+					if (!head.is_success()) return false;
+					bool written = sink.writeAt(offset, data, size);
+					offset += size;
+					return written;
+				});
+			if (response.error.empty() && !response.is_success()) {
+				response.error = "Download failed with status " + std::to_string(response.status_code) + ".";
+			}
+			return response;
+		}
+
+		// Sorts inclusive byte ranges and merges overlapping or adjacent ones
+		static std::vector<std::pair<uint64_t, uint64_t>> mergeRanges(std::vector<std::pair<uint64_t, uint64_t>> ranges) {
+			std::sort(ranges.begin(), ranges.end());
+			std::vector<std::pair<uint64_t, uint64_t>> merged;
+			for (const auto& range : ranges) {
+				if (!merged.empty() && range.first <= merged.back().second + 1) {
+					merged.back().second = (std::max)(merged.back().second, range.second);
+				}
+				else {
+					merged.push_back(range);
+				}
+			}
+			return merged;
+		}
+
+		// Loads completed ranges from a download journal if it describes the same object
+		static bool readJournal(const std::string& path, uint64_t total, const std::string& validator,
+			std::vector<std::pair<uint64_t, uint64_t>>& done) {
+			std::ifstream in(detail::pathFromUtf8(path), std::ios::binary);
+			std::string magic, totalLine, validatorLine;
+			if (!std::getline(in, magic) || magic != "HttpClient-journal 1" ||
+				!std::getline(in, totalLine) || std::strtoull(totalLine.c_str(), nullptr, 10) != total ||
+				!std::getline(in, validatorLine) || validatorLine != validator) {
+				return false;
+			}
+			std::string line;
+			while (std::getline(in, line)) {
+				// A last line without its newline was torn by a crash
+				if (in.eof()) break;
+				uint64_t first = 0, last = 0;
+				if (std::sscanf(line.c_str(), "%llu %llu", reinterpret_cast<unsigned long long*>(&first),
+					reinterpret_cast<unsigned long long*>(&last)) != 2 || first > last || last >= total) {
+					break;
+				}
+				done.emplace_back(first, last);
+			}
+			done = mergeRanges(std::move(done));
+			return true;
+		}
+
+		// Returns the gaps left by done in [0, total), split so up to `segments` can run at once
+		std::vector<std::pair<uint64_t, uint64_t>> missingRanges(const std::vector<std::pair<uint64_t, uint64_t>>& done,
+			uint64_t total, int segments) const {
+			std::vector<std::pair<uint64_t, uint64_t>> gaps;
+			uint64_t next = 0;
+			for (const auto& range : done) {
+				if (range.first > next) gaps.emplace_back(next, range.first - 1);
+				next = range.second + 1;
+			}
+			if (next < total) gaps.emplace_back(next, total - 1);
+
+			// Halve the largest gap until there are enough segments or they would get too small
+			uint64_t minSegment = (std::max<uint64_t>)(1, download_options_.min_segment_bytes);
+			while (!gaps.empty() && gaps.size() < static_cast<size_t>((std::max)(1, segments))) {
+				auto largest = std::max_element(gaps.begin(), gaps.end(), [](const auto& a, const auto& b) {
+					return a.second - a.first < b.second - b.first;
+				});
+				uint64_t length = largest->second - largest->first + 1;
+				if (length / 2 < minSegment) break;
+				uint64_t middle = largest->first + length / 2;
+				uint64_t last = largest->second;
+				largest->second = middle - 1;
+				gaps.emplace_back(middle, last);
+			}
+			return gaps;
+		}
+
+		// Fetches byte ranges (inclusive) concurrently, one connection per range. onRangeProgress,
+		// if set, is told about every chunk written so callers can persist progress.
+		HttpResponse downloadRanges(const std::string& url, DownloadSink& sink,
+			const std::unordered_map<std::string, std::string>& headers, HttpResponse result,
+			const std::vector<std::pair<uint64_t, uint64_t>>& ranges, const std::string& validator,
+			const std::function<void(uint64_t offset, uint64_t size)>& onRangeProgress) const {
+			std::atomic<bool> failed{ false };
+			std::mutex errorMutex;
+			HttpResponse failure;
+			// Workers run on their own threads, so carry over this thread's timeouts and deadline
+			TimeoutPolicy timeouts = currentTimeouts();
+			auto deadline = TimeoutScope::deadline();
+			std::stop_token stop = detail::StopScope::token();
+
+			auto worker = [&](uint64_t first, uint64_t last) {
+				TimeoutScope inherited(timeouts, deadline);
+				detail::StopScope inheritedStop(stop);
+				uint64_t next = first;
+				for (int attempt = 0; attempt < (std::max)(1, download_options_.max_segment_attempts) && next <= last && !failed; ++attempt) {
+					auto rangeHeaders = headers;
+					rangeHeaders["Range"] = "bytes=" + std::to_string(next) + "-" + std::to_string(last);
+					if (!validator.empty()) {
+						rangeHeaders["If-Range"] = validator;
+					}
+					bool sinkFailed = false;
+					HttpResponse response = sendStreaming("GET", url, rangeHeaders,
+						[&](const HttpResponse& head, const char* data, size_t size) {
+							// Anything but 206 means the range was ignored or the object changed
+							if (head.status_code != 206 || failed) return false;
+							size = static_cast<size_t>((std::min<uint64_t>)(size, last - next + 1));
+							if (!sink.writeAt(next, data, size)) {
+								sinkFailed = true;
+								return false;
+							}
+							if (onRangeProgress) onRangeProgress(next, size);
+							next += size;
+							return next <= last;
+						});
+					if (next > last) {
+						return;
+					}
+
+					// Dropped connections, truncated ranges and transient server errors resume; anything else is final
+					int status = response.status_code;
+					bool resumable = !sinkFailed && response.error_kind != ErrorKind::Cancelled &&
+						(status == 0 || status == 206 || status == 429 || status >= 500);
+					if (!resumable || attempt + 1 >= (std::max)(1, download_options_.max_segment_attempts)) {
+						std::lock_guard<std::mutex> lock(errorMutex);
+						if (!failed.exchange(true)) {
+							failure = response;
+							if (sinkFailed) {
+								failure.error = "Failed to write to download sink.";
+							}
+							else if (response.status_code == 200) {
+								failure.error = "Resource changed or ignored the range request during download.";
+							}
+							else if (failure.error.empty() && status == 206) {
+								failure.error = "Range response ended before the requested range was complete.";
+							}
+							else if (failure.error.empty()) {
+								failure.error = "Range request failed with status " + std::to_string(response.status_code) + ".";
+							}
+						}
+						return;
+					}
+				}
+			};
+
+			std::vector<std::thread> threads;
+			for (size_t i = 1; i < ranges.size(); ++i) {
+				threads.emplace_back(worker, ranges[i].first, ranges[i].second);
+			}
+			if (!ranges.empty()) {
+				worker(ranges[0].first, ranges[0].second);
+			}
+			for (auto& thread : threads) {
+				thread.join();
+			}
+
+			if (failed) {
+				return failure;
+			}
+			result.status_code = 200;
+			result.body.clear();
+			return result;
+		}
+
+		// Sends a request whose URL has already been parsed, consulting the response cache when enabled
+		HttpResponse sendParsed(const std::string& method, const std::string& scheme,
+			const std::string& host, unsigned short port, const std::string& path,
+			const std::string& data,
+			const std::unordered_map<std::string, std::string>& headers,
+			const UploadBody* upload = nullptr, const BodyCallback* onBody = nullptr) const {
+			// A streamed body is handed to the caller, never stored
+			if (!response_cache_ || onBody) {
+				return sendWithRetries(method, scheme, host, port, path, data, headers, onBody, upload);
+			}
+
+			std::string cacheKey = scheme + "://" + host + ":" + std::to_string(port) + path;
+			if (method == "GET") {
+				return sendCached(cacheKey, scheme, host, port, path, headers);
+			}
+
+			HttpResponse response = sendWithRetries(method, scheme, host, port, path, data, headers, nullptr, upload);
+			if (method != "HEAD" && method != "OPTIONS" && method != "TRACE" &&
+				response.error_kind == ErrorKind::None && response.status_code < 400) {
+				// A successful unsafe method invalidates the stored response (RFC 9111 section 4.4)
+				response_cache_->erase(cacheKey);
+			}
+			return response;
+		}
+
+		// Serves a GET from the cache when fresh, otherwise fetches or revalidates it
+		HttpResponse sendCached(const std::string& cacheKey, const std::string& scheme,
+			const std::string& host, unsigned short port, const std::string& path,
+			const std::unordered_map<std::string, std::string>& headers) const {
+			const std::string* cacheControl = detail::findHeader(headers, "Cache-Control");
+			auto requestDirectives = detail::parseCacheControl(cacheControl ? *cacheControl : "");
+			// Caller-driven conditional or partial requests bypass the cache entirely
+			if (requestDirectives.count("no-store") || detail::findHeader(headers, "Range") ||
+				detail::findHeader(headers, "If-None-Match") || detail::findHeader(headers, "If-Modified-Since")) {
+				return sendWithRetries("GET", scheme, host, port, path, "", headers);
+			}
+
+			auto stored = response_cache_->lookup(cacheKey, headers);
+			auto now = std::chrono::system_clock::now();
+			const std::string* pragma = detail::findHeader(headers, "Pragma");
+			bool forceRevalidate = requestDirectives.count("no-cache") ||
+				detail::deltaSeconds(requestDirectives, "max-age") == 0 ||
+				(pragma && detail::toLower(*pragma).find("no-cache") != std::string::npos);
+			if (stored && !forceRevalidate && stored->isFresh(now)) {
+				return responseFromEntry(*stored, now);
+			}
+
+			auto requestHeaders = headers;
+			bool conditional = stored && stored->hasValidator();
+			if (conditional) {
+				if (!stored->etag.empty()) requestHeaders["If-None-Match"] = stored->etag;
+				if (!stored->last_modified.empty()) requestHeaders["If-Modified-Since"] = stored->last_modified;
+			}
+
+			auto requestTime = std::chrono::system_clock::now();
+			HttpResponse response = sendWithRetries("GET", scheme, host, port, path, "", requestHeaders);
+			auto responseTime = std::chrono::system_clock::now();
+			if (response.error_kind != ErrorKind::None) {
+				return response;
+			}
+
+			if (conditional && response.status_code == 304) {
+				auto refreshed = response_cache_->freshen(*stored, response, headers, requestTime, responseTime);
+				response_cache_->recordRevalidation(cacheKey);
+				if (!refreshed) {
+					response_cache_->erase(cacheKey);
+					HttpResponse result = responseFromEntry(*stored, responseTime);
+					result.attempts = response.attempts;
+					return result;
+				}
+				response_cache_->store(cacheKey, refreshed);
+				HttpResponse result = responseFromEntry(*refreshed, responseTime);
+				result.attempts = response.attempts;
+				return result;
+			}
+
+			if (auto entry = response_cache_->makeEntry(response, headers, requestTime, responseTime)) {
+				response_cache_->store(cacheKey, std::move(entry));
+			}
+			else if (stored) {
+				response_cache_->erase(cacheKey);
+			}
+			return response;
+		}
+
+		// Materializes a cached entry as a response, with a current Age header
+		HttpResponse responseFromEntry(const ResponseCache::Entry& entry, std::chrono::system_clock::time_point now) const {
+			HttpResponse response;
+			response.status_code = entry.status_code;
+			// The headers are copied either way, since the Age header is rewritten per response
+			response.headers = entry.headers;
+			if (response_cache_->zeroCopy()) {
+				response.setBodyView(entry.body, entry.body_owner);
+			}
+			else {
+				response.body.assign(entry.body);
+			}
+			std::string age = std::to_string(entry.currentAge(now).count());
+			if (std::string* existing = const_cast<std::string*>(detail::findHeader(response.headers, "Age"))) {
+				*existing = age;
+			}
+			else {
+				response.headers["Age"] = age;
+			}
+			response.from_cache = true;
+			return response;
+		}
+
+		// Sends an HTTP request, retrying idempotent methods according to the retry policy
+		HttpResponse sendWithRetries(const std::string& method, const std::string& scheme,
+			const std::string& host, unsigned short port, const std::string& path,
+			const std::string& data,
+			const std::unordered_map<std::string, std::string>& headers,
+			const BodyCallback* onBody = nullptr, const UploadBody* upload = nullptr) const {
+			// A streamed body cannot be taken back, so only attempts that delivered nothing are retried
+			bool delivered = false;
+			BodyCallback tracking;
+			const BodyCallback* sink = onBody;
+			if (onBody) {
+				tracking = [&](const HttpResponse& head, const char* chunk, size_t size) {
+					delivered = true;
+					return (*onBody)(head, chunk, size);
+				};
+				sink = &tracking;
+			}
+
+			// Logical hosts are resolved per attempt so a retry can land on another backend
+			auto group = endpoint_groups_->find(host);
+			auto attemptOnce = [&]() {
+				return !group
+					? sendAttempt(method, scheme, host, port, path, data, headers, sink, upload)
+					: sendToGroup(*group, method, path, data, headers, sink, upload);
+			};
+
+			const RetryPolicy& policy = retry_policy_;
+			// An upload is consumed as it is sent and cannot be replayed
+			if (policy.max_attempts <= 1 || !detail::isIdempotentMethod(method) || upload) {
+				HttpResponse response = attemptOnce();
+				response.attempts = 1;
+				return response;
+			}
+
+			auto budget = retry_budgets_->forHost(host, policy);
+			budget->deposit();
+
+			std::chrono::milliseconds previousDelay = policy.base_delay;
+			for (int attempt = 1;; ++attempt) {
+				HttpResponse response = attemptOnce();
+				response.attempts = attempt;
+
+				std::optional<std::chrono::milliseconds> retryAfter;
+				if (delivered || !shouldRetry(response, policy, retryAfter) || attempt >= policy.max_attempts ||
+					!budget->tryWithdraw()) {
+					return response;
+				}
+
+				// Decorrelated jitter: delay = min(max_delay, random(base, previous * 3))
+				auto upper = (std::max)(policy.base_delay, previousDelay * 3);
+				std::uniform_int_distribution<long long> dist(policy.base_delay.count(), upper.count());
+				auto delay = (std::min)(policy.max_delay, std::chrono::milliseconds{ dist(detail::randomEngine()) });
+				previousDelay = delay;
+				if (retryAfter) {
+					delay = (std::max)(delay, *retryAfter);
+				}
+				// Never wait past the deadline for an attempt that could not finish in time
+				auto deadline = TimeoutScope::deadline();
+				if (deadline && std::chrono::steady_clock::now() + delay >= *deadline) {
+					return response;
+				}
+				if (!detail::sleepUnlessStopped(delay)) {
+					HttpResponse cancelled = cancelledResponse();
+					cancelled.attempts = attempt;
+					return cancelled;
+				}
+			}
+		}
+
+		// Decides whether a response warrants another attempt and extracts any Retry-After delay
+		bool shouldRetry(const HttpResponse& response, const RetryPolicy& policy,
+			std::optional<std::chrono::milliseconds>& retryAfter) const {
+			if (response.error_kind == ErrorKind::Transport || response.error_kind == ErrorKind::Timeout) {
+				return true;
+			}
+			if (response.error_kind != ErrorKind::None ||
+				std::find(policy.retry_status_codes.begin(), policy.retry_status_codes.end(),
+					response.status_code) == policy.retry_status_codes.end()) {
+				return false;
+			}
+			if (policy.honor_retry_after) {
+				retryAfter = detail::parseRetryAfter(response.getHeader("Retry-After"));
+				if (retryAfter && *retryAfter > policy.max_retry_after) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// Sends one attempt to the backend the group selects and feeds back its outcome
+		HttpResponse sendToGroup(EndpointGroup& group, const std::string& method, const std::string& path,
+			const std::string& data,
+			const std::unordered_map<std::string, std::string>& headers,
+			const BodyCallback* onBody, const UploadBody* upload = nullptr) const {
+			EndpointGroup::Backend backend;
+			size_t index = group.acquire(backend);
+			auto start = std::chrono::steady_clock::now();
+			HttpResponse response = sendAttempt(method, backend.scheme, backend.host, backend.port, path, data, headers, onBody, upload);
+			// A local rejection (open breaker, full limiter) or a cancellation never reached the
+			// backend, so it says nothing about its health or latency
+			if (response.error_kind == ErrorKind::CircuitOpen || response.error_kind == ErrorKind::Overloaded ||
+				response.error_kind == ErrorKind::Cancelled) {
+				group.abandon(index);
+				return response;
+			}
+			bool failed = response.error_kind == ErrorKind::Transport ||
+				response.error_kind == ErrorKind::Timeout || response.status_code >= 500;
+			group.release(index, failed, std::chrono::steady_clock::now() - start);
+			return response;
+		}
+
+		// Performs one attempt, guarded by the origin's circuit breaker and concurrency limiter when enabled
+		HttpResponse sendAttempt(const std::string& method, const std::string& scheme,
+			const std::string& host, unsigned short port, const std::string& path,
+			const std::string& data,
+			const std::unordered_map<std::string, std::string>& headers,
+			const BodyCallback* onBody = nullptr, const UploadBody* upload = nullptr) const {
+			if (!circuit_breakers_ && !concurrency_limiters_) {
+				return sendOnce(method, scheme, host, port, path, data, headers, onBody, upload);
+			}
+
+			std::string origin = host + ":" + std::to_string(port);
+			std::shared_ptr<CircuitBreaker> breaker;
+			uint64_t probe = 0;
+			if (circuit_breakers_) {
+				breaker = circuit_breakers_->forOrigin(origin);
+				if (!breaker->tryAcquire(probe)) {
+					HttpResponse response;
+					response.error = "Circuit breaker open for " + origin + ".";
+					response.error_kind = ErrorKind::CircuitOpen;
+					return response;
+				}
+			}
+
+			std::shared_ptr<ConcurrencyLimiter> limiter;
+			if (concurrency_limiters_) {
+				limiter = concurrency_limiters_->forOrigin(origin);
+				ErrorKind admission = limiter->acquire();
+				if (admission != ErrorKind::None) {
+					if (breaker) breaker->abandon(probe);
+					if (admission == ErrorKind::Cancelled) {
+						return cancelledResponse();
+					}
+					HttpResponse response;
+					response.error = admission == ErrorKind::Timeout ? "Request deadline exceeded."
+						: "Concurrency limit reached for " + origin + ".";
+					response.error_kind = admission;
+					return response;
+				}
+			}
+
+			auto start = std::chrono::steady_clock::now();
+			HttpResponse response = sendOnce(method, scheme, host, port, path, data, headers, onBody, upload);
+			auto latency = std::chrono::steady_clock::now() - start;
+
+			// A cancelled attempt frees its slots without counting as a sample
+			if (response.error_kind == ErrorKind::Cancelled) {
+				if (limiter) limiter->abandon();
+				if (breaker) breaker->abandon(probe);
+				return response;
+			}
+			if (limiter) {
+				bool dropped = response.error_kind == ErrorKind::Transport || response.error_kind == ErrorKind::Timeout ||
+					response.status_code == 429 || response.status_code == 503;
+				limiter->release(latency, dropped);
+			}
+			if (breaker) {
+				bool failed = response.error_kind == ErrorKind::Transport ||
+					response.error_kind == ErrorKind::Timeout || response.status_code >= 500;
+				breaker->onResult(failed, latency, probe);
+			}
+			return response;
+		}
+
+		// Applies per-request options and builds the request's header block, including jar cookies
+		std::wstring prepareRequest(HINTERNET hRequest, const std::string& host, const std::string& path, bool isHttps,
+			const std::unordered_map<std::string, std::string>& headers) const {
+			// Keep requests independent: the shared session must not replay cookies, and
+			// redirects are followed by sendFollowingRedirects so each hop sees the cache and jar
+			DWORD disabledFeatures = WINHTTP_DISABLE_COOKIES | WINHTTP_DISABLE_REDIRECTS;
+			WinHttpSetOption(hRequest, WINHTTP_OPTION_DISABLE_FEATURE, &disabledFeatures, sizeof(disabledFeatures));
+
+			const TlsOptions& tls = pool_->tls();
+			if (isHttps && !tls.verify_peer) {
+				DWORD securityFlags = SECURITY_FLAG_IGNORE_UNKNOWN_CA | SECURITY_FLAG_IGNORE_CERT_DATE_INVALID |
+					SECURITY_FLAG_IGNORE_CERT_CN_INVALID | SECURITY_FLAG_IGNORE_CERT_WRONG_USAGE;
+				WinHttpSetOption(hRequest, WINHTTP_OPTION_SECURITY_FLAGS, &securityFlags, sizeof(securityFlags));
+			}
+			if (isHttps && tls.check_revocation) {
+				DWORD features = WINHTTP_ENABLE_SSL_REVOCATION;
+				WinHttpSetOption(hRequest, WINHTTP_OPTION_ENABLE_FEATURE, &features, sizeof(features));
+			}
+
+			const ProxyOptions& proxy = pool_->proxy();
+			if (!proxy.username.empty()) {
+				std::wstring username = toWideString(proxy.username);
+				std::wstring password = toWideString(proxy.password);
+				WinHttpSetOption(hRequest, WINHTTP_OPTION_PROXY_USERNAME, (LPVOID)username.c_str(), static_cast<DWORD>(username.length()));
+				WinHttpSetOption(hRequest, WINHTTP_OPTION_PROXY_PASSWORD, (LPVOID)password.c_str(), static_cast<DWORD>(password.length()));
+			}
+
+			std::wstring headerString;
+			for (const auto& [key, value] : headers) {
+				headerString += toWideString(key) + L": " + toWideString(value) + L"\r\n";
+			}
+			// A caller-supplied Cookie header takes precedence over the jar
+			if (cookie_jar_ && !detail::findHeader(headers, "Cookie")) {
+				std::string cookies = cookie_jar_->cookieHeader(host, path.substr(0, path.find('?')), isHttps);
+				if (!cookies.empty()) {
+					headerString += L"Cookie: " + toWideString(cookies) + L"\r\n";
+				}
+			}
+			return headerString;
+		}
+
+		// Reads status line, protocol and headers of a received response; false on failure,
+		// including when watch has closed the handle
+		bool readResponseHead(HINTERNET hRequest, const std::string& host, const std::string& path, HttpResponse& response,
+			const detail::RequestWatch* watch = nullptr) const {
+			auto closed = [watch]() { return watch && watch->reason() != detail::RequestWatch::Reason::None; };
+			response.protocol = "HTTP/1.1";
+			if (closed()) return false;
+#ifdef WINHTTP_OPTION_HTTP_PROTOCOL_USED
+			DWORD protocolUsed = 0;
+			DWORD protocolSize = sizeof(protocolUsed);
+			if (WinHttpQueryOption(hRequest, WINHTTP_OPTION_HTTP_PROTOCOL_USED, &protocolUsed, &protocolSize) &&
+				(protocolUsed & WINHTTP_PROTOCOL_FLAG_HTTP2)) {
+				response.protocol = "HTTP/2";
+			}
+#endif
+
+			// Get status code
+			DWORD dwStatusCode = 0;
+			DWORD dwSize = sizeof(dwStatusCode);
+			if (!closed() && WinHttpQueryHeaders(hRequest,
+				WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+				WINHTTP_HEADER_NAME_BY_INDEX,
+				&dwStatusCode,
+				&dwSize,
+				WINHTTP_NO_HEADER_INDEX)) {
+				response.status_code = static_cast<int>(dwStatusCode);
+			}
+			else {
+				response.error = "WinHttpQueryHeaders for status code failed.";
+				return false;
+			}
+
+			// Get response headers
+			DWORD dwHeaderSize = 0;
+			if (closed()) return false;
+			WinHttpQueryHeaders(hRequest,
+				WINHTTP_QUERY_RAW_HEADERS_CRLF,
+				WINHTTP_HEADER_NAME_BY_INDEX,
+				NULL,
+				&dwHeaderSize,
+				WINHTTP_NO_HEADER_INDEX);
+			std::vector<wchar_t> headerBuffer(dwHeaderSize / sizeof(wchar_t));
+			if (closed()) return false;
+			if (WinHttpQueryHeaders(hRequest,
+				WINHTTP_QUERY_RAW_HEADERS_CRLF,
+				WINHTTP_HEADER_NAME_BY_INDEX,
+				&headerBuffer[0],
+				&dwHeaderSize,
+				WINHTTP_NO_HEADER_INDEX)) {
+				std::wstring headersW(headerBuffer.begin(), headerBuffer.end() - 1); // Remove last null
+				std::string headersA = toUTF8String(headersW);
+				response.parseHeaders(headersA);
+				if (cookie_jar_ && !response.set_cookies.empty()) {
+					cookie_jar_->store(host, path, response.set_cookies);
+				}
+			}
+			return true;
+		}
+
+		// Streams an upload body after the request head, framing it when chunked; stops once
+		// watch has closed the handle
+		static bool writeUpload(HINTERNET request, const UploadBody& upload, bool chunked,
+			const detail::RequestWatch* watch = nullptr) {
+			auto writeAll = [request, watch](const char* data, size_t size) {
+				while (size > 0) {
+					DWORD written = 0;
+					if (watch && watch->reason() != detail::RequestWatch::Reason::None) {
+						return false;
+					}
+					if (!WinHttpWriteData(request, data, static_cast<DWORD>(size), &written) || written == 0) {
+						return false;
+					}
+					data += written;
+					size -= written;
+				}
+				return true;
+			};
+
+			std::vector<char> buffer(64 * 1024);
+			char frame[24];
+			for (;;) {
+				size_t size = upload.read(buffer.data(), buffer.size());
+				if (size == 0) break;
+				if (chunked) {
+					int frameSize = std::snprintf(frame, sizeof(frame), "%zx\r\n", size);
+					if (!writeAll(frame, static_cast<size_t>(frameSize))) return false;
+				}
+				if (!writeAll(buffer.data(), size)) return false;
+				if (chunked && !writeAll("\r\n", 2)) return false;
+			}
+			return !chunked || writeAll("0\r\n\r\n", 5);
+		}
+
+		static HttpResponse cancelledResponse() {
+			HttpResponse response;
+			response.error = "Request cancelled.";
+			response.error_kind = ErrorKind::Cancelled;
+			return response;
+		}
+
+		// Sets the phase timeouts on a request, each capped by the time left before the deadline
+		static bool applyTimeouts(HINTERNET hRequest, const TimeoutPolicy& timeouts,
+			std::optional<std::chrono::steady_clock::time_point> deadline) {
+			std::optional<std::chrono::milliseconds> remaining;
+			if (deadline) {
+				remaining = (std::max)(std::chrono::ceil<std::chrono::milliseconds>(*deadline - std::chrono::steady_clock::now()),
+					std::chrono::milliseconds{ 1 });
+			}
+			auto apply = [&](DWORD option, std::chrono::milliseconds phase) {
+				std::optional<std::chrono::milliseconds> limit;
+				if (phase.count() > 0) limit = phase;
+				if (remaining) limit = limit ? (std::min)(*limit, *remaining) : *remaining;
+				if (!limit) return true; // Keep WinHTTP's default
+				DWORD value = static_cast<DWORD>((std::min<long long>)(limit->count(), 0x7FFFFFFF));
+				return WinHttpSetOption(hRequest, option, &value, sizeof(value)) != FALSE;
+			};
+			return apply(WINHTTP_OPTION_RESOLVE_TIMEOUT, timeouts.connect) &&
+				apply(WINHTTP_OPTION_CONNECT_TIMEOUT, timeouts.connect) &&
+				apply(WINHTTP_OPTION_SEND_TIMEOUT, timeouts.tls_handshake) &&
+				apply(WINHTTP_OPTION_RECEIVE_RESPONSE_TIMEOUT, timeouts.first_byte) &&
+				apply(WINHTTP_OPTION_RECEIVE_TIMEOUT, timeouts.read_idle);
+		}
+
+		// Performs a single request/response exchange over the pooled session
+		HttpResponse sendOnce(const std::string& method, const std::string& scheme,
+			const std::string& host, unsigned short port, const std::string& path,
+			const std::string& data,
+			const std::unordered_map<std::string, std::string>& headers,
+			const BodyCallback* onBody = nullptr, const UploadBody* upload = nullptr) const {
+			HttpResponse response;
+			response.error_kind = ErrorKind::Transport;
+			if (detail::StopScope::token().stop_requested()) {
+				return cancelledResponse();
+			}
+			auto deadline = TimeoutScope::deadline();
+			if (deadline && std::chrono::steady_clock::now() >= *deadline) {
+				response.error = "Request deadline exceeded.";
+				response.error_kind = ErrorKind::Timeout;
+				return response;
+			}
+			try {
+				bool isHttps = (scheme == "https");
+
+				// Connect to server through the shared session
+				HINTERNET hConnect = pool_->connect(toWideString(host), port);
+				if (!hConnect) {
+					response.error = pool_->session() ? "WinHttpConnect failed." : "WinHttpOpen failed.";
+					return response;
+				}
 
 				// Open request
 				WinHttpHandle hRequest(WinHttpOpenRequest(
-					hConnect.get(),
+					hConnect,
 					toWideString(method).c_str(),
 					toWideString(path).c_str(),
 					NULL,
@@ -246,10 +5033,58 @@ namespace HttpClientLib {
 					return response;
 				}
 
+				// Phase timeouts bound each WinHTTP call; the watch enforces the deadline across
+				// all of them and closes the request as soon as the caller asks to stop
+				if (!applyTimeouts(hRequest.get(), currentTimeouts(), deadline)) {
+					response.error = "Failed to set request timeouts.";
+					return response;
+				}
+				std::optional<detail::RequestWatch> watch;
+				// Once the watch has closed the handle it must not be used again
+				auto closed = [&]() { return watch && watch->reason() != detail::RequestWatch::Reason::None; };
+				auto fail = [&](const std::string& call) {
+					auto reason = watch ? watch->reason() : detail::RequestWatch::Reason::None;
+					if (reason == detail::RequestWatch::Reason::Stopped) {
+						response = cancelledResponse();
+					}
+					else if (reason == detail::RequestWatch::Reason::Deadline) {
+						response.error = "Request deadline exceeded.";
+						response.error_kind = ErrorKind::Timeout;
+					}
+					else if (GetLastError() == ERROR_WINHTTP_TIMEOUT) {
+						response.error = call + " timed out.";
+						response.error_kind = ErrorKind::Timeout;
+					}
+					else {
+						response.error = call + " failed.";
+					}
+					return response;
+				};
+
 				// Set headers
-				std::wstring headerString;
-				for (const auto& [key, value] : headers) {
-					headerString += toWideString(key) + L": " + toWideString(value) + L"\r\n";
+				std::wstring headerString = prepareRequest(hRequest.get(), host, path, isHttps, headers);
+				// WinHTTP takes the total length as a DWORD; larger or unknown lengths are declared by header
+				DWORD totalLength = data.empty() ? 0 : static_cast<DWORD>(data.length());
+				bool chunked = upload && !upload->length;
+#ifdef WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL
+				if (chunked && pool_->http2()) {
+					// HTTP/2 has no chunked coding (RFC 9113 section 8.2.2), so keep this request on
+					// HTTP/1.1 where the framing written by writeUpload is valid
+					DWORD protocols = 0;
+					WinHttpSetOption(hRequest.get(), WINHTTP_OPTION_ENABLE_HTTP_PROTOCOL, &protocols, sizeof(protocols));
+				}
+#endif
+				if (upload) {
+					totalLength = WINHTTP_IGNORE_REQUEST_TOTAL_LENGTH;
+					if (chunked) {
+						headerString += L"Transfer-Encoding: chunked\r\n";
+					}
+					else if (*upload->length > MAXDWORD) {
+						headerString += L"Content-Length: " + std::to_wstring(*upload->length) + L"\r\n";
+					}
+					else {
+						totalLength = static_cast<DWORD>(*upload->length);
+					}
 				}
 				if (!headerString.empty()) {
 					if (!WinHttpAddRequestHeaders(hRequest.get(), headerString.c_str(),
@@ -260,80 +5095,96 @@ namespace HttpClientLib {
 					}
 				}
 
+				// Armed only now, so the setup calls above never see a closed handle
+				const std::stop_token& stop = detail::StopScope::token();
+				if (deadline || stop.stop_possible()) {
+					watch.emplace(hRequest, deadline, stop);
+				}
+
 				// Send request
+				if (closed()) {
+					return fail("WinHttpSendRequest");
+				}
 				BOOL bResult = WinHttpSendRequest(
 					hRequest.get(),
 					WINHTTP_NO_ADDITIONAL_HEADERS,
 					0,
-					(LPVOID)(data.empty() ? NULL : data.c_str()),
-					data.empty() ? 0 : static_cast<DWORD>(data.length()),
-					data.empty() ? 0 : static_cast<DWORD>(data.length()),
+					(LPVOID)(data.empty() || upload ? NULL : data.c_str()),
+					data.empty() || upload ? 0 : static_cast<DWORD>(data.length()),
+					totalLength,
 					0);
 
 				if (!bResult) {
-					response.error = "WinHttpSendRequest failed.";
-					return response;
+					return fail("WinHttpSendRequest");
+				}
+
+				const detail::RequestWatch* watchPtr = watch ? &*watch : nullptr;
+				if (upload && !writeUpload(hRequest.get(), *upload, chunked, watchPtr)) {
+					return fail("WinHttpWriteData");
 				}
 
 				// Receive response
-				bResult = WinHttpReceiveResponse(hRequest.get(), NULL);
+				bResult = !closed() && WinHttpReceiveResponse(hRequest.get(), NULL);
 				if (!bResult) {
-					response.error = "WinHttpReceiveResponse failed.";
-					return response;
+					return fail("WinHttpReceiveResponse");
 				}
 
-				// Get status code
-				DWORD dwStatusCode = 0;
-				DWORD dwSize = sizeof(dwStatusCode);
-				if (WinHttpQueryHeaders(hRequest.get(),
-					WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-					WINHTTP_HEADER_NAME_BY_INDEX,
-					&dwStatusCode,
-					&dwSize,
-					WINHTTP_NO_HEADER_INDEX)) {
-					response.status_code = static_cast<int>(dwStatusCode);
-				}
-				else {
-					response.error = "WinHttpQueryHeaders for status code failed.";
-					return response;
+				if (!readResponseHead(hRequest.get(), host, path, response, watchPtr)) {
+					return closed() ? fail("WinHttpQueryHeaders") : response;
 				}
 
-				// Get response headers
-				DWORD dwHeaderSize = 0;
-				WinHttpQueryHeaders(hRequest.get(),
-					WINHTTP_QUERY_RAW_HEADERS_CRLF,
-					WINHTTP_HEADER_NAME_BY_INDEX,
-					NULL,
-					&dwHeaderSize,
-					WINHTTP_NO_HEADER_INDEX);
-				std::vector<wchar_t> headerBuffer(dwHeaderSize / sizeof(wchar_t));
-				if (WinHttpQueryHeaders(hRequest.get(),
-					WINHTTP_QUERY_RAW_HEADERS_CRLF,
-					WINHTTP_HEADER_NAME_BY_INDEX,
-					&headerBuffer[0],
-					&dwHeaderSize,
-					WINHTTP_NO_HEADER_INDEX)) {
-					std::wstring headersW(headerBuffer.begin(), headerBuffer.end() - 1); // Remove last null
-					std::string headersA = toUTF8String(headersW);
-					response.parseHeaders(headersA);
-				}
-
-				// Read response body
-				std::vector<char> buffer(4096);
+				// Read response body. A buffered body is read straight into its final string,
+				// sized from Content-Length when known, so bulk transfers are never copied again
+				// after WinHTTP decrypts them. Streamed bodies go through a reused 64 KB buffer.
+				constexpr size_t kReadChunk = 64 * 1024;
 				DWORD dwBytesRead = 0;
-				std::string responseBody;
-				do {
-					if (!WinHttpReadData(hRequest.get(), buffer.data(), static_cast<DWORD>(buffer.size()), &dwBytesRead)) {
-						response.error = "WinHttpReadData failed.";
-						return response;
+				if (onBody) {
+					std::vector<char> buffer(kReadChunk);
+					do {
+						if (closed() || !WinHttpReadData(hRequest.get(), buffer.data(), static_cast<DWORD>(buffer.size()), &dwBytesRead)) {
+							return fail("WinHttpReadData");
+						}
+						if (dwBytesRead > 0 && !(*onBody)(response, buffer.data(), dwBytesRead)) {
+							response.error = "Transfer aborted by body callback.";
+							response.error_kind = ErrorKind::Aborted;
+							return response;
+						}
+					} while (dwBytesRead > 0);
+				}
+				else {
+					std::string responseBody;
+					size_t used = 0;
+					bool hasBody = method != "HEAD" && response.status_code >= 200 &&
+						response.status_code != 204 && response.status_code != 304;
+					std::string contentLength = response.getHeader("Content-Length");
+					if (hasBody && !contentLength.empty() &&
+						std::all_of(contentLength.begin(), contentLength.end(), [](unsigned char c) { return std::isdigit(c); })) {
+						// Reserve for the declared length, but only up to 1 MB so a server cannot make
+						// the client allocate memory it never sends. The spare byte lets the final
+						// zero-length read finish without growing the string.
+						responseBody.reserve(static_cast<size_t>((std::min<unsigned long long>)(
+							std::strtoull(contentLength.c_str(), nullptr, 10) + 1, 1024ull * 1024)));
 					}
-					responseBody.append(buffer.data(), dwBytesRead);
-				} while (dwBytesRead > 0);
-				response.body = responseBody;
+					do {
+						if (responseBody.size() == used) {
+							// Use the reserved capacity first, then grow geometrically with what actually arrives
+							responseBody.resize((std::max)({ responseBody.capacity(), responseBody.size() * 2, used + kReadChunk }));
+						}
+						DWORD room = static_cast<DWORD>((std::min<size_t>)(responseBody.size() - used, MAXDWORD));
+						if (closed() || !WinHttpReadData(hRequest.get(), responseBody.data() + used, room, &dwBytesRead)) {
+							return fail("WinHttpReadData");
+						}
+						used += dwBytesRead;
+					} while (dwBytesRead > 0);
+					responseBody.resize(used);
+					response.body = std::move(responseBody);
+				}
+				response.error_kind = ErrorKind::None;
 
 			}
 			catch (const std::exception& ex) {
 				response.error = ex.what();
+				response.error_kind = ErrorKind::InvalidRequest;
 			}
 
 			return response;
@@ -0,0 +1,256 @@
+// HpackTests.cpp
+// Conformance tests for Hpack.h against the examples of RFC 7541 Appendix C.
+// Hpack.h has no platform dependencies, so these build and run anywhere:
+//   g++ -std=c++17 -I. tests/HpackTests.cpp -o hpack_tests && ./hpack_tests
+
+#include "Hpack.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace HttpClientLib::hpack;
+
+namespace {
+
+	int failures = 0;
+
+	void check(bool condition, const char* what, int line) {
+		if (!condition) {
+			std::printf("FAILED line %d: %s\n", line, what);
+			++failures;
+		}
+	}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+	// Parses the RFC's hex dumps, ignoring spaces
+	std::string fromHex(const std::string& hex) {
+		std::string digits;
+		for (char c : hex) {
+			if (c != ' ') digits += c;
+		}
+		std::string out;
+		for (size_t i = 0; i + 1 < digits.size(); i += 2) {
+			out += static_cast<char>(std::stoi(digits.substr(i, 2), nullptr, 16));
+		}
+		return out;
+	}
+
+	std::string toHex(const std::string& bytes) {
+		static const char* digits = "0123456789abcdef";
+		std::string out;
+		for (unsigned char c : bytes) {
+			out += digits[c >> 4];
+			out += digits[c & 15];
+		}
+		return out;
+	}
+
+	// Dynamic table entries, newest first, as the RFC lists them
+	bool tableIs(const DynamicTable& table, const std::vector<HeaderField>& expected, size_t size) {
+		if (table.count() != expected.size() || table.size() != size) return false;
+		for (size_t i = 0; i < expected.size(); ++i) {
+			if (!(table.at(i) == expected[i])) return false;
+		}
+		return true;
+	}
+
+	bool decodesTo(Decoder& decoder, const std::string& hex, const std::vector<HeaderField>& expected) {
+		try {
+			return decoder.decode(fromHex(hex)) == expected;
+		}
+		catch (const HpackError&) {
+			return false;
+		}
+	}
+
+	bool encodesTo(Encoder& encoder, const std::vector<HeaderField>& fields, const std::string& hex) {
+		return toHex(encoder.encode(fields)) == toHex(fromHex(hex));
+	}
+
+	// C.1: integer representation
+	void integers() {
+		std::string out;
+		detail::encodeInteger(10, 5, 0, out);
+		CHECK(toHex(out) == "0a");
+		out.clear();
+		detail::encodeInteger(1337, 5, 0, out);
+		CHECK(toHex(out) == "1f9a0a");
+		out.clear();
+		detail::encodeInteger(42, 8, 0, out);
+		CHECK(toHex(out) == "2a");
+
+		std::string bytes = fromHex("1f9a0a");
+		const uint8_t* p = reinterpret_cast<const uint8_t*>(bytes.data());
+		CHECK(detail::decodeInteger(p, p + bytes.size(), 5) == 1337);
+	}
+
+	// C.2: header field representations
+	void fieldRepresentations() {
+		{
+			// C.2.1: literal with indexing
+			Encoder encoder;
+			encoder.setHuffman(false);
+			CHECK(encodesTo(encoder, { { "custom-key", "custom-header" } },
+				"400a 6375 7374 6f6d 2d6b 6579 0d63 7573 746f 6d2d 6865 6164 6572"));
+			Decoder decoder;
+			CHECK(decodesTo(decoder, "400a 6375 7374 6f6d 2d6b 6579 0d63 7573 746f 6d2d 6865 6164 6572",
+				{ { "custom-key", "custom-header" } }));
+			CHECK(tableIs(decoder.table(), { { "custom-key", "custom-header" } }, 55));
+		}
+		{
+			// C.2.2: literal without indexing
+			Decoder decoder;
+			CHECK(decodesTo(decoder, "040c 2f73 616d 706c 652f 7061 7468", { { ":path", "/sample/path" } }));
+			CHECK(tableIs(decoder.table(), {}, 0));
+		}
+		{
+			// C.2.3: literal never indexed
+			Encoder encoder;
+			encoder.setHuffman(false);
+			CHECK(encodesTo(encoder, { { "password", "secret", true } }, "1008 7061 7373 776f 7264 0673 6563 7265 74"));
+			CHECK(encoder.table().count() == 0);
+			Decoder decoder;
+			auto fields = decoder.decode(fromHex("1008 7061 7373 776f 7264 0673 6563 7265 74"));
+			CHECK(fields.size() == 1 && fields[0] == HeaderField("password", "secret") && fields[0].sensitive);
+			CHECK(tableIs(decoder.table(), {}, 0));
+		}
+		{
+			// C.2.4: indexed
+			Encoder encoder;
+			CHECK(encodesTo(encoder, { { ":method", "GET" } }, "82"));
+			Decoder decoder;
+			CHECK(decodesTo(decoder, "82", { { ":method", "GET" } }));
+		}
+	}
+
+	// C.3 (plain) and C.4 (Huffman): three requests on one connection
+	void requests(bool huffman) {
+		const std::vector<HeaderField> first = {
+			{ ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" } };
+		const std::vector<HeaderField> second = {
+			{ ":method", "GET" }, { ":scheme", "http" }, { ":path", "/" }, { ":authority", "www.example.com" },
+			{ "cache-control", "no-cache" } };
+		const std::vector<HeaderField> third = {
+			{ ":method", "GET" }, { ":scheme", "https" }, { ":path", "/index.html" }, { ":authority", "www.example.com" },
+			{ "custom-key", "custom-value" } };
+		const char* blocks[2][3] = {
+			{ "8286 8441 0f77 7777 2e65 7861 6d70 6c65 2e63 6f6d",
+			  "8286 84be 5808 6e6f 2d63 6163 6865",
+			  "8287 85bf 400a 6375 7374 6f6d 2d6b 6579 0c63 7573 746f 6d2d 7661 6c75 65" },
+			{ "8286 8441 8cf1 e3c2 e5f2 3a6b a0ab 90f4 ff",
+			  "8286 84be 5886 a8eb 1064 9cbf",
+			  "8287 85bf 4088 25a8 49e9 5ba9 7d7f 8925 a849 e95b b8e8 b4bf" } };
+		const char* const* hex = blocks[huffman ? 1 : 0];
+
+		Encoder encoder;
+		encoder.setHuffman(huffman);
+		Decoder decoder;
+
+		CHECK(encodesTo(encoder, first, hex[0]));
+		CHECK(decodesTo(decoder, hex[0], first));
+		CHECK(tableIs(decoder.table(), { { ":authority", "www.example.com" } }, 57));
+
+		CHECK(encodesTo(encoder, second, hex[1]));
+		CHECK(decodesTo(decoder, hex[1], second));
+		CHECK(tableIs(decoder.table(), { { "cache-control", "no-cache" }, { ":authority", "www.example.com" } }, 110));
+
+		CHECK(encodesTo(encoder, third, hex[2]));
+		CHECK(decodesTo(decoder, hex[2], third));
+		CHECK(tableIs(decoder.table(), {
+			{ "custom-key", "custom-value" }, { "cache-control", "no-cache" }, { ":authority", "www.example.com" } }, 164));
+		CHECK(tableIs(encoder.table(), {
+			{ "custom-key", "custom-value" }, { "cache-control", "no-cache" }, { ":authority", "www.example.com" } }, 164));
+	}
+
+	// C.5 (plain) and C.6 (Huffman): three responses with a 256-octet table, forcing evictions
+	void responses(bool huffman) {
+		const std::vector<HeaderField> first = {
+			{ ":status", "302" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+			{ "location", "https://www.example.com" } };
+		const std::vector<HeaderField> second = {
+			{ ":status", "307" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+			{ "location", "https://www.example.com" } };
+		const std::vector<HeaderField> third = {
+			{ ":status", "200" }, { "cache-control", "private" }, { "date", "Mon, 21 Oct 2013 20:13:22 GMT" },
+			{ "location", "https://www.example.com" }, { "content-encoding", "gzip" },
+			{ "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" } };
+		const char* blocks[2][3] = {
+			{ "4803 3330 3258 0770 7269 7661 7465 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 "
+			  "3120 474d 546e 1768 7474 7073 3a2f 2f77 7777 2e65 7861 6d70 6c65 2e63 6f6d",
+			  "4803 3330 37c1 c0bf",
+			  "88c1 611d 4d6f 6e2c 2032 3120 4f63 7420 3230 3133 2032 303a 3133 3a32 3220 474d 54c0 5a04 677a 6970 "
+			  "7738 666f 6f3d 4153 444a 4b48 514b 425a 584f 5157 454f 5049 5541 5851 5745 4f49 553b 206d 6178 2d61 "
+			  "6765 3d33 3630 303b 2076 6572 7369 6f6e 3d31" },
+			{ "4882 6402 5885 aec3 771a 4b61 96d0 7abe 9410 54d4 44a8 2005 9504 0b81 66e0 82a6 2d1b ff6e 919d 29ad "
+			  "1718 63c7 8f0b 97c8 e9ae 82ae 43d3",
+			  "4883 640e ffc1 c0bf",
+			  "88c1 6196 d07a be94 1054 d444 a820 0595 040b 8166 e084 a62d 1bff c05a 839b d9ab 77ad 94e7 821d d7f2 "
+			  "e6c7 b335 dfdf cd5b 3960 d5af 2708 7f36 72c1 ab27 0fb5 291f 9587 3160 65c0 03ed 4ee5 b106 3d50 07" } };
+		const char* const* hex = blocks[huffman ? 1 : 0];
+
+		Encoder encoder(256);
+		encoder.setHuffman(huffman);
+		Decoder decoder(256);
+
+		CHECK(encodesTo(encoder, first, hex[0]));
+		CHECK(decodesTo(decoder, hex[0], first));
+		CHECK(tableIs(decoder.table(), {
+			{ "location", "https://www.example.com" }, { "date", "Mon, 21 Oct 2013 20:13:21 GMT" },
+			{ "cache-control", "private" }, { ":status", "302" } }, 222));
+
+		CHECK(encodesTo(encoder, second, hex[1]));
+		CHECK(decodesTo(decoder, hex[1], second));
+		CHECK(tableIs(decoder.table(), {
+			{ ":status", "307" }, { "location", "https://www.example.com" },
+			{ "date", "Mon, 21 Oct 2013 20:13:21 GMT" }, { "cache-control", "private" } }, 222));
+
+		CHECK(encodesTo(encoder, third, hex[2]));
+		CHECK(decodesTo(decoder, hex[2], third));
+		CHECK(tableIs(decoder.table(), {
+			{ "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" },
+			{ "content-encoding", "gzip" }, { "date", "Mon, 21 Oct 2013 20:13:22 GMT" } }, 215));
+		CHECK(tableIs(encoder.table(), {
+			{ "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" },
+			{ "content-encoding", "gzip" }, { "date", "Mon, 21 Oct 2013 20:13:22 GMT" } }, 215));
+	}
+
+	// Malformed blocks must be rejected rather than decoded (RFC 7541 sections 2.3.3, 4.2, 5.2 and 6.3)
+	void malformed() {
+		auto rejects = [](const std::string& hex) {
+			Decoder decoder;
+			try {
+				decoder.decode(fromHex(hex));
+			}
+			catch (const HpackError&) {
+				return true;
+			}
+			return false;
+		};
+		CHECK(rejects("80"));       // Index 0
+		CHECK(rejects("be"));       // Dynamic index into an empty table
+		CHECK(rejects("3fe21f"));   // Size update above the advertised 4096
+		CHECK(rejects("8220"));     // Size update after a header field
+		CHECK(rejects("0081ff"));   // Huffman padding longer than 7 bits
+		CHECK(rejects("4007"));     // String length past the end of the block
+		CHECK(rejects("1fffffffffffffffffffff")); // Integer overflow
+	}
+
+}
+
+int main() {
+	integers();
+	fieldRepresentations();
+	requests(false);
+	requests(true);
+	responses(false);
+	responses(true);
+	malformed();
+	if (failures) {
+		std::printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("All HPACK tests passed\n");
+	return 0;
+}
@@ -0,0 +1,183 @@
+// ParserTests.cpp
+// Checks the parsers behind the proxy, event stream and JSON Lines support on
+// hand-written input, without a network. They live in HttpClient.h, so this
+// builds against the Windows SDK:
+//   cl /std:c++20 /EHsc /I. tests\ParserTests.cpp winhttp.lib && ParserTests.exe
+
+#include "HttpClient.h"
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace HttpClientLib;
+
+namespace {
+
+	int failures = 0;
+
+	void check(bool condition, const char* what, int line) {
+		if (!condition) {
+			std::printf("FAILED line %d: %s\n", line, what);
+			++failures;
+		}
+	}
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+	std::string proxyName(const std::string& url) {
+		std::string hostPort;
+		return detail::parseProxyUrl(url, hostPort) ? hostPort : "invalid";
+	}
+
+	bool poolAccepts(const std::string& url) {
+		ProxyOptions proxy;
+		proxy.url = url;
+		try {
+			ConnectionPool pool(L"ParserTests", proxy);
+			return true;
+		}
+		catch (const std::invalid_argument&) {
+			return false;
+		}
+	}
+
+	void proxyUrls() {
+		CHECK(proxyName("http://proxy.corp:3128") == "proxy.corp:3128");
+		CHECK(proxyName("http://proxy.corp") == "proxy.corp:80");
+		CHECK(proxyName("http://proxy.corp:8080/") == "proxy.corp:8080");
+		CHECK(proxyName("http://10.0.0.1:8080") == "10.0.0.1:8080");
+		CHECK(proxyName("https://proxy.corp:443") == "invalid");
+		CHECK(proxyName("proxy.corp:3128") == "invalid");
+		CHECK(proxyName("http://proxy.corp:0") == "invalid");
+		CHECK(proxyName("http://proxy.corp:65536") == "invalid");
+		CHECK(proxyName("http://proxy.corp:99999999999") == "invalid");
+		CHECK(proxyName("") == "invalid");
+
+		CHECK(poolAccepts(""));
+		CHECK(poolAccepts("http://proxy.corp:3128"));
+		CHECK(!poolAccepts("socks5://proxy.corp:1080"));
+		CHECK(!poolAccepts("http://proxy.corp:70000"));
+	}
+
+	// Feeds the stream in chunks of chunkSize bytes and collects "event|id|data" per event
+	std::vector<std::string> events(EventStreamParser& parser, const std::string& stream, size_t chunkSize) {
+		std::vector<std::string> out;
+		for (size_t i = 0; i < stream.size(); i += chunkSize) {
+			parser.feed(stream.data() + i, (std::min)(chunkSize, stream.size() - i), [&](const ServerSentEvent& event) {
+				out.push_back(event.event + "|" + event.id + "|" + event.data);
+				return true;
+			});
+		}
+		return out;
+	}
+
+	void eventStreams() {
+		const std::string stream =
+			"\xEF\xBB\xBF: comment\r\n"
+			"data: first\r\n"
+			"data:second line\r\n"
+			"\r\n"
+			"event: update\n"
+			"id: 7\n"
+			"retry: 2500\n"
+			"data\n"
+			"\n"
+			"id: 8\r"
+			"data: {\"a\":1}\r"
+			"\r"
+			"data: unterminated";
+		const std::vector<std::string> expected = {
+			"message||first\nsecond line",
+			"update|7|",
+			"message|8|{\"a\":1}",
+		};
+		// Every chunk size, so CRLF pairs and the BOM are split across feeds
+		for (size_t chunkSize = 1; chunkSize <= stream.size(); ++chunkSize) {
+			EventStreamParser parser;
+			CHECK(events(parser, stream, chunkSize) == expected);
+			CHECK(parser.lastEventId() == "8");
+			CHECK(parser.retry() == std::chrono::milliseconds(2500));
+		}
+
+		// An event with no data is not dispatched; a bad retry value is ignored
+		EventStreamParser parser;
+		CHECK(events(parser, "event: empty\nretry: 1x\n\ndata: x\n\n", 64) == std::vector<std::string>{ "message||x" });
+		CHECK(!parser.retry());
+
+		// reset drops the partial event but keeps the last ID for the reconnect
+		parser.feed("id: 9\ndata: lost", 16, [](const ServerSentEvent&) { return true; });
+		parser.reset();
+		CHECK(events(parser, "data: kept\n\n", 64) == std::vector<std::string>{ "message|9|kept" });
+
+		// onEvent returning false stops the parser
+		int seen = 0;
+		std::string two = "data: a\n\ndata: b\n\n";
+		CHECK(!parser.feed(two.data(), two.size(), [&](const ServerSentEvent&) { return ++seen < 1; }));
+		CHECK(seen == 1);
+
+		EventStreamParser small(8);
+		std::string big = "data: 0123456789\n\n";
+		CHECK(!small.feed(big.data(), big.size(), [](const ServerSentEvent&) { return true; }));
+		CHECK(small.overflowed());
+	}
+
+	// Feeds the lines in chunks of chunkSize bytes, then finishes; returns the
+	// records' "n" values, or "error: ..." once the parser fails
+	std::vector<std::string> records(const std::string& lines, size_t chunkSize, JsonLinesOptions options = {}) {
+		JsonLinesParser parser(options);
+		std::vector<std::string> out;
+		auto onRecord = [&](nlohmann::json&& record) {
+			out.push_back(record.at("n").dump());
+			return true;
+		};
+		bool ok = true;
+		for (size_t i = 0; ok && i < lines.size(); i += chunkSize) {
+			ok = parser.feed(lines.data() + i, (std::min)(chunkSize, lines.size() - i), onRecord);
+		}
+		if (ok) ok = parser.finish(onRecord);
+		if (!ok) out.push_back("error: " + parser.error());
+		return out;
+	}
+
+	void jsonLines() {
+		const std::string lines = "{\"n\":1}\n\n  \r\n{\"n\": \"two\"}\r\n{\"n\":[3]}";
+		const std::vector<std::string> expected = { "1", "\"two\"", "[3]" };
+		// Every chunk size, so records are split anywhere, including inside CRLF
+		for (size_t chunkSize = 1; chunkSize <= lines.size(); ++chunkSize) {
+			CHECK(records(lines, chunkSize) == expected);
+		}
+
+		CHECK(records("{\"n\":1}\n{oops\n{\"n\":3}\n", 4) ==
+			(std::vector<std::string>{ "1", "error: Invalid JSON on line 2." }));
+		JsonLinesOptions skip;
+		skip.skip_invalid = true;
+		CHECK(records("{\"n\":1}\n{oops\n{\"n\":3}\n", 4, skip) == (std::vector<std::string>{ "1", "3" }));
+
+		JsonLinesOptions small;
+		small.max_line_size = 10;
+		CHECK(records("{\"n\":1}\n{\"n\":\"0123456789\"}\n", 3, small) ==
+			(std::vector<std::string>{ "1", "error: JSON line 2 exceeds max_line_size." }));
+
+		// onRecord returning false stops the parser without an error
+		JsonLinesParser parser;
+		int seen = 0;
+		std::string two = "{\"n\":1}\n{\"n\":2}\n";
+		CHECK(!parser.feed(two.data(), two.size(), [&](nlohmann::json&&) { return ++seen < 1; }));
+		CHECK(seen == 1 && parser.stopped() && parser.error().empty());
+	}
+
+} // namespace
+
+int main() {
+	proxyUrls();
+	eventStreams();
+	jsonLines();
+	if (failures) {
+		std::printf("%d check(s) failed\n", failures);
+		return 1;
+	}
+	std::printf("All parser tests passed\n");
+	return 0;
+}